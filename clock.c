@@ -1,6 +1,6 @@
 /* 
  * clock.c - Routines for using the cycle counters on x86, 
- *           Alpha, and Sparc boxes.
+ *           Alpha, and Sparc boxes, or the monotonic clock.
  * 
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
@@ -9,8 +9,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
 #include <sys/times.h>
 #include "clock.h"
+#include "config.h"
+
+#if USE_RDTSCP || USE_MONOTONIC
+/* Read CLOCK_MONOTONIC_RAW, which NTP does not slew, in nanoseconds */
+static unsigned long long monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
 
 
 /******************************************************* 
@@ -21,7 +34,104 @@
  * You can verify this for yourself using gcc -v.
  *******************************************************/
 
-#if defined(__i386__)  
+#if USE_RDTSCP && defined(__x86_64__)
+/*******************************************************
+ * x86-64 versions of start_counter() and get_counter()
+ *******************************************************/
+#include <cpuid.h>
+
+static unsigned long long cyc_start = 0;
+static int tsc_invariant = -1;   /* not checked yet */
+
+/* 
+ * The TSC only counts time if it runs at a constant rate through
+ * frequency and sleep state changes, which CPUID reports as an
+ * "invariant TSC". Without one, count nanoseconds instead.
+ */
+static int check_tsc(void)
+{
+    unsigned eax, ebx, ecx, edx;
+
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 ||
+	eax < 0x80000007)
+	return 0;
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    if (!(edx & (1 << 8))) {
+	fprintf(stderr, "Warning: no invariant TSC, timing with clock_gettime\n");
+	return 0;
+    }
+    return 1;
+}
+
+/* 
+ * rdtscp waits for the instructions before it to finish, so the
+ * timed code cannot leak past the read that ends a measurement.
+ */
+static unsigned long long access_counter(void)
+{
+    unsigned hi, lo, aux;
+
+    if (tsc_invariant < 0)
+	tsc_invariant = check_tsc();
+    if (!tsc_invariant)
+	return monotonic_ns();
+    asm volatile("rdtscp" : "=a" (lo), "=d" (hi), "=c" (aux));
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+/* Record the current value of the cycle counter. */
+void start_counter()
+{
+    cyc_start = access_counter();
+}
+
+/* Return the number of cycles since the last call to start_counter. */
+double get_counter()
+{
+    return (double)(access_counter() - cyc_start);
+}
+
+unsigned long long read_counter(void)
+{
+    return access_counter();
+}
+
+const char *counter_name(void)
+{
+    if (tsc_invariant < 0)
+	tsc_invariant = check_tsc();
+    return tsc_invariant ? "rdtscp" : "clock_gettime(CLOCK_MONOTONIC_RAW)";
+}
+
+#elif USE_MONOTONIC
+/*******************************************************
+ * start_counter() and get_counter() on the monotonic
+ * clock, counting nanoseconds ("cycles" of a 1GHz clock)
+ *******************************************************/
+
+static unsigned long long cyc_start = 0;
+
+void start_counter()
+{
+    cyc_start = monotonic_ns();
+}
+
+double get_counter()
+{
+    return (double)(monotonic_ns() - cyc_start);
+}
+
+unsigned long long read_counter(void)
+{
+    return monotonic_ns();
+}
+
+const char *counter_name(void)
+{
+    return "clock_gettime(CLOCK_MONOTONIC_RAW)";
+}
+
+#elif defined(__i386__)  
 /*******************************************************
  * Pentium versions of start_counter() and get_counter()
  *******************************************************/
@@ -71,6 +181,19 @@ double get_counter()
 }
 /* $end x86cyclecounter */
 
+unsigned long long read_counter(void)
+{
+    unsigned hi, lo;
+
+    access_counter(&hi, &lo);
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+const char *counter_name(void)
+{
+    return "rdtsc";
+}
+
 #elif defined(__alpha)
 
 /****************************************************
@@ -133,6 +256,16 @@ double get_counter()
     return result;
 }
 
+unsigned long long read_counter(void)
+{
+    return counter();
+}
+
+const char *counter_name(void)
+{
+    return "rpcc";
+}
+
 #else
 
 /****************************************************************
@@ -158,6 +291,19 @@ double get_counter()
     printf("Please choose another timing package in config.h.\n");
     exit(1);
 }
+
+unsigned long long read_counter(void)
+{
+    printf("ERROR: You are trying to use a read_counter routine in clock.c\n");
+    printf("that has not been implemented yet on this platform.\n");
+    printf("Please choose another timing package in config.h.\n");
+    exit(1);
+}
+
+const char *counter_name(void)
+{
+    return "a cycle counter";
+}
 #endif
 
 
@@ -195,11 +341,32 @@ double mhz_full(int verbose, int sleeptime)
 }
 /* $end mhz */
 
+#if USE_RDTSCP || USE_MONOTONIC
+/* 
+ * With a counter that runs at a constant rate, the rate can be read
+ * off CLOCK_MONOTONIC_RAW over a short busy wait instead of a sleep
+ */
+double mhz(int verbose)
+{
+    unsigned long long t0, t1;
+    double rate;
+
+    t0 = monotonic_ns();
+    start_counter();
+    while ((t1 = monotonic_ns()) - t0 < 20000000)   /* 20ms */
+	;
+    rate = get_counter() / ((t1 - t0) / 1e3);
+    if (verbose) 
+	printf("Processor clock rate ~= %.1f MHz\n", rate);
+    return rate;
+}
+#else
 /* Version using a default sleeptime */
 double mhz(int verbose)
 {
     return mhz_full(verbose, 2);
 }
+#endif
 
 /** Special counters that compensate for timer interrupt overhead */
 
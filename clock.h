@@ -6,6 +6,12 @@ void start_counter();
 /* Get # cycles since counter started */
 double get_counter();
 
+/* Read the counter itself, for timing many short intervals */
+unsigned long long read_counter(void);
+
+/* Name of the counter that is actually read, for the -v report */
+const char *counter_name(void);
+
 /* Measure overhead for counter */
 double ovhd();
 
@@ -53,20 +53,42 @@
 #define UTIL_WEIGHT .60
 
 /* 
- * Alignment requirement in bytes (either 4 or 8) 
+ * Alignment requirement in bytes (8 on 32-bit, 16 on x86-64, like malloc)
  */
+#if __SIZEOF_POINTER__ == 8
+#define ALIGNMENT 16
+#else
 #define ALIGNMENT 8  
+#endif
 
-/* 
- * Maximum heap size in bytes 
+/*
+ * Address space reserved for each heap region. memlib maps it with no
+ * access and commits pages only as the brk reaches them, so a large
+ * reservation costs no memory until it is used.
  */
-#define MAX_HEAP (20*(1<<20))  /* 20 MB */
+#if __SIZEOF_POINTER__ == 8
+#define MAX_HEAP ((size_t)1 << 32)    /* 4 GB per region */
+#else
+#define MAX_HEAP ((size_t)128 << 20)  /* 128 MB per region */
+#endif
 
 /*****************************************************************************
  * Set exactly one of these USE_xxx constants to "1" to select a timing method
  *****************************************************************************/
-#define USE_FCYC   0   /* cycle counter w/K-best scheme (x86 & Alpha only) */
+#define USE_FCYC   1   /* counter below w/K-best scheme */
 #define USE_ITIMER 0   /* interval timer (any Unix box) */
-#define USE_GETTOD 1   /* gettimeofday (any Unix box) */
+#define USE_GETTOD 0   /* gettimeofday (any Unix box) */
+
+/*
+ * The counter clock.c reads for USE_FCYC. With neither set, it falls
+ * back to the old rdtsc (32-bit x86) and rpcc (Alpha) code.
+ */
+#if defined(__x86_64__)
+#define USE_RDTSCP    1 /* time-stamp counter; needs an invariant TSC */
+#define USE_MONOTONIC 0 /* clock_gettime(CLOCK_MONOTONIC_RAW) in ns */
+#else
+#define USE_RDTSCP    0
+#define USE_MONOTONIC 1
+#endif
 
 #endif /* __CONFIG_H */
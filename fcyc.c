@@ -127,12 +127,19 @@ static void clear()
  * fcyc - Use K-best scheme to estimate the running time of function f
  */
 double fcyc(test_funct f, void *argp)
+{
+    return fcyc_prep(NULL, f, argp);
+}
+
+double fcyc_prep(test_funct prep, test_funct f, void *argp)
 {
     double result;
     init_sampler();
     if (compensate) {
 	do {
 	    double cyc;
+	    if (prep)
+		prep(argp);
 	    if (clear_cache)
 		clear();
 	    start_comp_counter();
@@ -143,6 +150,8 @@ double fcyc(test_funct f, void *argp)
     } else {
 	do {
 	    double cyc;
+	    if (prep)
+		prep(argp);
 	    if (clear_cache)
 		clear();
 	    start_counter();
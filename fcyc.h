@@ -13,6 +13,9 @@ typedef void (*test_funct)(void *);
 /* Compute number of cycles used by test function f */
 double fcyc(test_funct f, void* argp);
 
+/* Same, but call prep(argp) before each measurement, outside the timing */
+double fcyc_prep(test_funct prep, test_funct f, void* argp);
+
 /*********************************************************
  * Set the various parameters used by measurement routines 
  *********************************************************/
@@ -21,12 +21,20 @@ void init_fsecs(void)
 
 #if USE_FCYC
     if (verbose)
-	printf("Measuring performance with a cycle counter.\n");
+	printf("Measuring performance with %s.\n", counter_name());
 
     /* set key parameters for the fcyc package */
     set_fcyc_maxsamples(20); 
     set_fcyc_clear_cache(1);
+#if USE_RDTSCP || USE_MONOTONIC
+    /* 
+     * Tick compensation spends seconds calibrating against times(), and
+     * K-best already drops the samples that a timer interrupt hit
+     */
+    set_fcyc_compensate(0);
+#else
     set_fcyc_compensate(1);
+#endif
     set_fcyc_epsilon(0.01);
     set_fcyc_k(3);
     Mhz = mhz(verbose > 0);
@@ -43,14 +51,30 @@ void init_fsecs(void)
  * fsecs - Return the running time of a function f (in seconds)
  */
 double fsecs(fsecs_test_funct f, void *argp) 
+{
+    return fsecs_prep(NULL, f, argp);
+}
+
+/*
+ * fsecs_prep - Same as fsecs, but call prep(argp) before each run of f,
+ *     and leave it out of the time
+ */
+double fsecs_prep(fsecs_test_funct prep, fsecs_test_funct f, void *argp) 
 {
 #if USE_FCYC
-    double cycles = fcyc(f, argp);
+    double cycles = fcyc_prep(prep, f, argp);
     return cycles/(Mhz*1e6);
-#elif USE_ITIMER
-    return ftimer_itimer(f, argp, 10);
-#elif USE_GETTOD
-    return ftimer_gettod(f, argp, 10);
+#else
+    double secs = 0;
+    int i;
+
+    if (prep == NULL)
+	return USE_ITIMER ? ftimer_itimer(f, argp, 10) : ftimer_gettod(f, argp, 10);
+    for (i = 0; i < 10; i++) {
+	prep(argp);
+	secs += USE_ITIMER ? ftimer_itimer(f, argp, 1) : ftimer_gettod(f, argp, 1);
+    }
+    return secs / 10;
 #endif 
 }
 
@@ -39,6 +39,8 @@ static void place(void *bp, size_t alloc_size);
 void mm_free(void *bp);
 static void *coalesce(void *bp);
 void *mm_realloc(void *old_bp, size_t req_size);
+static size_t adjust_size(size_t req_size);
+static void shrink_block(void *bp, size_t alloc_size);
 
 
 //정렬 기준, 64비트 시스템은 보통 시작주소를 8바이트의 배수가 되도록 정렬함.
@@ -53,7 +55,8 @@ void *mm_realloc(void *old_bp, size_t req_size);
 
 // 가용 리스트 조작을 위한 기본 상수 및 매크로 정의
 #define WSIZE 4 // 워드나 헤더,푸터
-#define DSIZE 8 // 더블워드
+#define DSIZE 8 // 더블워드, 헤더 + 푸터
+#define ALIGN_SIZE (2*DSIZE) // 페이로드 시작과 블록 크기의 정렬 단위. x86-64 malloc처럼 16바이트, 가용이 되면 헤더와 푸터가 들어가는 최소 블록이기도 함
 #define CHUNKSIZE (1<<12) //초기 가용 블록과 힙 확장을 위한 기본 크기
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))
@@ -67,9 +70,16 @@ void *mm_realloc(void *old_bp, size_t req_size);
 #define GET_SIZE(p)  (GET(p) & ~0x7) //~0x7은 1111 1000임.그래서 마지막 3비트만 버리는 용도. // 블록 전체 크기
 #define GET_ALLOC(p)  (GET(p) & 0x1) //마지막 1비트만 가져오는 용도.
 
+// 할당된 블록은 푸터가 없다. 대신 헤더의 두 번째 비트에 앞블럭이 할당됐는지를 적어둔다.
+// 푸터는 가용 블록에만 있고, 병합할 때 앞블럭이 가용일 때만 읽는다.
+#define PREV_ALLOC  0x2
+#define GET_PREV_ALLOC(p)  (GET(p) & PREV_ALLOC) // 앞블럭의 할당상태
+#define SET_PREV_ALLOC(p)  PUT(p, GET(p) | PREV_ALLOC)
+#define CLR_PREV_ALLOC(p)  PUT(p, GET(p) & ~PREV_ALLOC)
+
 //block ptr = 실제 데이터를 저장하는 위치를 가리키는 포인터
 #define HDRP(bp)    ((char*)(bp) - WSIZE) // bp보다 1워드 앞에 헤더포인트가 있음.!
-#define FTRP(bp)    ((char*)(bp) + GET_SIZE(HDRP(bp)) - DSIZE) // GET_SIZE(HDRP(bp))는 헤더와 푸터를 포함한 전체 블록크기(헤더,페이로드,푸터)를 의미함.
+#define FTRP(bp)    ((char*)(bp) + GET_SIZE(HDRP(bp)) - DSIZE) // GET_SIZE(HDRP(bp))는 헤더와 푸터를 포함한 전체 블록크기(헤더,페이로드,푸터)를 의미함. 가용 블록에만 있음.
 
 #define NEXT_BLKP(bp)    ((char*)(bp) + GET_SIZE((char*)(bp) - WSIZE)) 
 // 헤더의 위치 계산해서, 헤더에서 블록의 전체 크기를 읽어온다. 다음 블럭의 시작 주소 계산
@@ -82,14 +92,14 @@ static char *heap_listp; // 힙에서 관리되는 블록 리스트의 시작 
 //최초 가용 블록으로 힙 생성하기.
 int mm_init(void)
 {
-    if ((heap_listp = mem_sbrk(4*WSIZE)) == (void *)-1) // 새로 할당된 힙 영역의 시작 주소를 저장하고 가리킴.
+    if ((heap_listp = mem_sbrk(2*ALIGN_SIZE)) == (void *)-1) // 새로 할당된 힙 영역의 시작 주소를 저장하고 가리킴.
     //mem_sbrk가 메모리를 할당하고 할당된 메모리 영역의 시작 주소를 반환하는 애임. 반환값이 -1이면 메모리 확장에 실패한것.
         return -1;
-    PUT(heap_listp, 0); // 첫부분에 0을 넣음. 이부분은 나중에 필요하지 않은 패딩 공간, 정렬을 맞추기 위해 필요하다.
-    PUT(heap_listp + (1*WSIZE), PACK(DSIZE, 1)); // 두번째 워드 위치에 블록 크기 8 바이트와 할당 상태를 저장함. 이부분이 프롤로그 블록의 헤더임. 힙의 시작을 표시
-    PUT(heap_listp + (2*WSIZE), PACK(DSIZE, 1)); // 세번째 워드 위치에도 똑같은 내용. 이부분이 프롤로그 블록의 푸터임.
-    PUT(heap_listp + (3*WSIZE), PACK(0, 1)); // 마지막 워드 위치에 블록 크기 0과 할당 상태 저장. 에필로그 블록. 힙의 끝을 나타내는 역할
-    heap_listp += (2*WSIZE); // 이동 전에는 프롤로그 블록의 헤더를 가리키고 있다가 후에는 프롤로그 블록 다음에 올 첫번째 실제 가용 블록의 시작 주소를 가리키게 됨.
+    memset(heap_listp, 0, ALIGN_SIZE - WSIZE); // 첫부분은 0으로 채운 패딩 공간. 프롤로그 bp가 16의 배수가 되도록 정렬을 맞추기 위해 필요하다.
+    PUT(heap_listp + ALIGN_SIZE - WSIZE, PACK(ALIGN_SIZE, 1)); // 프롤로그 블록의 헤더. 힙의 시작을 표시
+    heap_listp += ALIGN_SIZE; // 프롤로그 블록의 bp. find_fit은 여기서부터 블록을 따라감.
+    PUT(heap_listp + ALIGN_SIZE - DSIZE, PACK(ALIGN_SIZE, 1)); // 프롤로그 블록의 푸터
+    PUT(heap_listp + ALIGN_SIZE - WSIZE, PACK(0, PREV_ALLOC | 1)); // 마지막 워드 위치에 블록 크기 0과 할당 상태 저장. 에필로그 블록. 힙의 끝을 나타내는 역할. 앞블럭(프롤로그)은 할당됨.
 
     if (extend_heap(CHUNKSIZE/WSIZE) == NULL) // 초기 힙 확장 크기 2의 12승 / 4 = 2의 10승 개의 워드 크기만큼 확장하겠다. 
         return -1;
@@ -101,13 +111,13 @@ static void *extend_heap(size_t words)
     char *bp;
     size_t size;
 
-    size = (words % 2) ? (words+1) * WSIZE : words * WSIZE; // 0이 False 짝수, 1이 True 홀수 -> 짝수 워드 단위로 관리하는게 효율적.
+    size = ((words * WSIZE + ALIGN_SIZE - 1) / ALIGN_SIZE) * ALIGN_SIZE; // 블록 크기는 정렬 단위(16)의 배수로 올림.
     if ((long)(bp = mem_sbrk(size)) == -1) // mem_sbrk 에서 반환된 값을 정수(큰 정수형 long)로 변환해서 -1인지 확인하기 위함이다.
         return NULL;
 
-    PUT(HDRP(bp), PACK(size, 0)); // 블록의 헤더 위치에 size만큼 가용상태를 기록
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)))); // 블록의 헤더 위치에 size만큼 가용상태를 기록. 앞블럭 상태는 원래 에필로그에 있던 것 그대로.
     PUT(FTRP(bp), PACK(size, 0));  // 푸터에도 똑같이!
-    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); // 다음 블록의 헤더에 에필로그 블록을 기록함.
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); // 다음 블록의 헤더에 에필로그 블록을 기록함. 앞블럭(새 블록)은 가용.
 
     return coalesce(bp); 
 }
@@ -127,11 +137,7 @@ void *mm_malloc(size_t req_size)
     if (req_size == 0)
         return NULL; // 사이즈가 0이면 할당할 필요가 없으니 NULL 반환
     
-    if (req_size <= DSIZE) // 요청한 크기가 너무 작으면 최소 8바이트 할당
-        alloc_size = 2*DSIZE; // 헤더 4, 페이로드 최소 8, 푸터4 = 최소16
-
-    else
-        alloc_size = DSIZE * ((req_size + (DSIZE) + (DSIZE-1)) / DSIZE); // 요청한 크기가 더 크면 8의 배수로 크기 맞춰서 정렬
+    alloc_size = adjust_size(req_size);
 
     if ((bp = find_fit(alloc_size)) != NULL) { // 빈공간 주소 bp에 저장
         place(bp, alloc_size); // 그 자리에 할당
@@ -145,7 +151,7 @@ void *mm_malloc(size_t req_size)
 }
 
 //빈공간을 찾아주는 함수, 요청한 크기만큼 맞는 빈 공간이 있으면 그 공간의 주소를 반환
-static void *find_fit(size_t alloc_size) // malloc에서 이미 요청한 크기에 헤더와 푸터를 포함한 크기를 alloc에 넣음.
+static void *find_fit(size_t alloc_size) // malloc에서 이미 요청한 크기에 헤더를 포함한 크기를 alloc에 넣음.
 {
     void *bp;
 
@@ -161,17 +167,17 @@ static void *find_fit(size_t alloc_size) // malloc에서 이미 요청한 크기
 static void place(void *bp, size_t alloc_size) 
 {
     size_t block_size = GET_SIZE(HDRP(bp)); 
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp)); // 앞블럭 상태는 그대로 유지
 
-    if ((block_size - alloc_size) >= (2*DSIZE)) { // 블럭에서 할당된 크기를 뺐는데도 최소 한 블럭 만들수 있는 크기 나오면 분할
-        PUT(HDRP(bp), PACK(alloc_size, 1)); // 헤더에 할당된 사이즈 할당
-        PUT(FTRP(bp), PACK(alloc_size, 1)); // 푸터에도 똑같이 저장
+    if ((block_size - alloc_size) >= ALIGN_SIZE) { // 블럭에서 할당된 크기를 뺐는데도 최소 한 블럭 만들수 있는 크기 나오면 분할
+        PUT(HDRP(bp), PACK(alloc_size, prev_alloc | 1)); // 헤더에 할당된 사이즈 할당. 푸터는 없음.
         bp = NEXT_BLKP(bp); // 다음 블럭 포인트, 할당된 사이즈 계산해서 옮기는거임.
-        PUT(HDRP(bp), PACK(block_size-alloc_size, 0)); // 남은 크기 정보에 넣어주고 가용상태로 만들기.
-        PUT(FTRP(bp), PACK(block_size-alloc_size, 0)); // 푸터에도 똑같이.
+        PUT(HDRP(bp), PACK(block_size-alloc_size, PREV_ALLOC)); // 남은 크기 정보에 넣어주고 가용상태로 만들기. 앞블럭은 방금 할당됨.
+        PUT(FTRP(bp), PACK(block_size-alloc_size, 0)); // 가용 블록이니 푸터도.
 
     } else { // 하나 만들 사이즈 안나오면 그냥 할당만 해주기.
-        PUT(HDRP(bp), PACK(block_size, 1)); 
-        PUT(FTRP(bp), PACK(block_size, 1));
+        PUT(HDRP(bp), PACK(block_size, prev_alloc | 1)); 
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp))); // 뒷블럭에게 앞블럭이 할당됐다고 알려줌.
     }
 }
 
@@ -180,15 +186,16 @@ void mm_free(void *bp)
 {
     size_t size = GET_SIZE(HDRP(bp)); //블록 크기 가져오기.
 
-    PUT(HDRP(bp), PACK(size, 0)); // 헤더에 블록크기와 가용상태를 기록함.
-    PUT(FTRP(bp), PACK(size, 0)); // 푸터에도
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)))); // 헤더에 블록크기와 가용상태를 기록함.
+    PUT(FTRP(bp), PACK(size, 0)); // 가용 블록이 됐으니 푸터도 씀
+    CLR_PREV_ALLOC(HDRP(NEXT_BLKP(bp))); // 뒷블럭에게 앞블럭이 가용이 됐다고 알려줌.
     coalesce(bp); // 위에 설명함.
 }
 
 // 새로 만든 블록이 인접 가용 블록들과 병합 가능한지 확인하고 가능하면 합치고 그 시작 주소를 반환함.
 static void *coalesce(void *bp) // 코얼레스 = 합체하다.
 {
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp))); // 앞블럭의 가용상태
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp)); // 앞블럭의 가용상태, 앞블럭 푸터는 가용일 때만 있으니 헤더 비트로 봄.
     size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp))); // 뒷블럭의 가용상태
     size_t size = GET_SIZE(HDRP(bp)); // 현재 블럭의 크기
 
@@ -197,36 +204,89 @@ static void *coalesce(void *bp) // 코얼레스 = 합체하다.
 
     } else if (prev_alloc && !next_alloc){ // 뒷블럭만 가용상태
         size += GET_SIZE(HDRP(NEXT_BLKP(bp))); // 사이즈를 뒷블럭 크기만큼 키움.
-        PUT(HDRP(bp), PACK(size, 0)); // 헤더 푸터 정보 갱신
+        PUT(HDRP(bp), PACK(size, PREV_ALLOC)); // 헤더 푸터 정보 갱신. 가용 블록끼리는 붙어있지 않으니 앞블럭은 항상 할당됨.
         PUT(FTRP(bp), PACK(size, 0));
 
     } else if (!prev_alloc && next_alloc){ // 앞블럭만 가용상태
         size += GET_SIZE(HDRP(PREV_BLKP(bp))); 
         PUT(FTRP(bp), PACK(size, 0)); 
         bp = PREV_BLKP(bp); // 헤더는 앞블럭의 헤더위치로 옮겨 줘야 함.
-        PUT(HDRP(bp), PACK(size, 0)); // 그 다음 헤더 정보 갱신
+        PUT(HDRP(bp), PACK(size, PREV_ALLOC)); // 그 다음 헤더 정보 갱신
 
     } else { 
         size += GET_SIZE(HDRP(PREV_BLKP(bp))) + GET_SIZE(FTRP(NEXT_BLKP(bp))); // 앞 뒤 블록 둘다 가용상태
         bp = PREV_BLKP(bp); // 헤더를 앞블럭의 헤더위치로 옮겨 줘야 함.
-        PUT(HDRP(bp), PACK(size, 0)); 
+        PUT(HDRP(bp), PACK(size, PREV_ALLOC)); 
         PUT(FTRP(bp), PACK(size, 0));
     }
     return bp;
 }
 
-// 메모리 블록의 크기를 변경할 때 사용됨. -> 기존 데이터를 새로운 블록으로 복사한 후 이전 블록을 해제함.
+// 요청 크기를 헤더를 포함하고 16의 배수로 맞춘 블록 크기로 바꿔줌. 할당된 블록엔 푸터가 없음.
+static size_t adjust_size(size_t req_size)
+{
+    return ALIGN_SIZE * ((req_size + (WSIZE) + (ALIGN_SIZE-1)) / ALIGN_SIZE); // 헤더만 더해서 16의 배수로 크기 맞춰서 정렬. 최소 블록도 16.
+}
+
+// 할당된 블록을 alloc_size로 줄이고, 남는 뒷부분이 한 블록이 되면 떼어서 가용으로 돌려줌.
+static void shrink_block(void *bp, size_t alloc_size)
+{
+    size_t block_size = GET_SIZE(HDRP(bp));
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+
+    if ((block_size - alloc_size) < ALIGN_SIZE) // 떼어낼 만큼 안 남으면 그대로 둠.
+        return;
+    PUT(HDRP(bp), PACK(alloc_size, prev_alloc | 1));
+    bp = NEXT_BLKP(bp);
+    PUT(HDRP(bp), PACK(block_size-alloc_size, PREV_ALLOC)); // 남는 부분은 가용 블록으로. 앞블럭은 할당 상태.
+    PUT(FTRP(bp), PACK(block_size-alloc_size, 0));
+    CLR_PREV_ALLOC(HDRP(NEXT_BLKP(bp))); // 뒷블럭에게 앞블럭이 가용이 됐다고 알려줌.
+    coalesce(bp); // 뒷블럭이 가용이면 합쳐짐.
+}
+
+// 메모리 블록의 크기를 변경할 때 사용됨.
+// 줄일 때는 제자리에서 뒷부분을 떼어주고, 늘릴 때는 뒷블럭이 가용이면 흡수하고, 힙 끝 블록이면 힙을 필요한 만큼만 늘려서 흡수함.
+// 제자리에서 안 될 때만 새 블록을 할당해서 데이터를 복사한 후 이전 블록을 해제함.
 void *mm_realloc(void *old_bp, size_t req_size) 
 {
-    void *new_bp;
-    size_t copySize;
-    
+    void *new_bp, *next_bp;
+    size_t copySize, alloc_size, old_size, avail_size;
+
+    if (old_bp == NULL) // realloc(NULL, size)는 malloc과 같음.
+        return mm_malloc(req_size);
+    if (req_size == 0) { // realloc(ptr, 0)은 free와 같음.
+        mm_free(old_bp);
+        return NULL;
+    }
+
+    alloc_size = adjust_size(req_size);
+    old_size = GET_SIZE(HDRP(old_bp));
+    if (alloc_size <= old_size) { // 줄이거나 그대로: 복사할 필요 없음.
+        shrink_block(old_bp, alloc_size);
+        return old_bp;
+    }
+
+    next_bp = NEXT_BLKP(old_bp);
+    avail_size = old_size + (GET_ALLOC(HDRP(next_bp)) ? 0 : GET_SIZE(HDRP(next_bp))); // 뒷블럭까지 합친 크기
+    if (avail_size < alloc_size && GET_SIZE(HDRP(GET_ALLOC(HDRP(next_bp)) ? next_bp : NEXT_BLKP(next_bp))) == 0) {
+        // 에필로그 바로 앞이면 모자란 만큼만 힙을 늘림. 새 공간은 뒷블럭(있으면)과 합쳐져서 next_bp 자리의 가용 블록이 됨.
+        // 못 늘리면(힙 한도) 아래에서 다른 가용 블록으로 옮겨 봄.
+        if (extend_heap((alloc_size - avail_size) / WSIZE) != NULL)
+            avail_size = alloc_size;
+    }
+    if (avail_size >= alloc_size) { // 뒷블럭을 흡수해서 제자리에서 늘림.
+        PUT(HDRP(old_bp), PACK(avail_size, GET_PREV_ALLOC(HDRP(old_bp)) | 1));
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(old_bp)));
+        shrink_block(old_bp, alloc_size); // 많이 남으면 다시 떼어줌.
+        return old_bp;
+    }
+
     new_bp = mm_malloc(req_size); 
     if (new_bp == NULL) // 할당 실패! 
       return NULL; 
 
-    copySize = GET_SIZE(HDRP(old_bp)) - DSIZE; // 기존 블록의 크기에서 헤더와 푸터 뺀 값을 복사, 새 블록으로 복사할 데이터의 크기
-    // 새로운 블록을 할당할 땐 새로운 헤더와 푸터가 필요하니까, 데이터만 복사함.
+    copySize = old_size - WSIZE; // 기존 블록의 크기에서 헤더 뺀 값을 복사, 새 블록으로 복사할 데이터의 크기 (할당된 블록엔 푸터가 없음)
+    // 새로운 블록을 할당할 땐 새로운 헤더가 필요하니까, 데이터만 복사함.
 
     if (req_size < copySize) // 요청한 크기(이것도 데이터만의 크기임)가 현재 블록크기보다 작으면 요청된 크기로 맞춰줌.
       copySize = req_size;
@@ -235,3 +295,6 @@ void *mm_realloc(void *old_bp, size_t req_size)
     mm_free(old_bp);
     return new_bp;
 }
+
+// mdriver에서 고를 수 있게 내보내는 함수 표. 심볼 이름은 MM_PREFIX를 따라감(mm.h).
+const mm_backend_t mm_backend = { MM_BACKEND_NAME, mm_init, mm_malloc, mm_free, mm_realloc };
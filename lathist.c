@@ -0,0 +1,92 @@
+/*
+ * lathist.c - Log-linear latency histograms (see lathist.h)
+ */
+#include <string.h>
+#include "lathist.h"
+
+/* function prototypes */
+static int hist_index(unsigned long long v);
+static unsigned long long hist_top(int i);
+
+/*
+ * hist_clear - Empty a histogram
+ */
+void hist_clear(hist_t *h)
+{
+    memset(h, 0, sizeof(hist_t));
+}
+
+/*
+ * hist_record - Count one value
+ */
+void hist_record(hist_t *h, unsigned long long v)
+{
+    h->bucket[hist_index(v)]++;
+    h->count++;
+    if (v > h->max)
+	h->max = v;
+}
+
+/*
+ * hist_merge - Add the counts of src to dst
+ */
+void hist_merge(hist_t *dst, hist_t *src)
+{
+    int i;
+
+    for (i = 0; i < HIST_BUCKETS; i++)
+	dst->bucket[i] += src->bucket[i];
+    dst->count += src->count;
+    if (src->max > dst->max)
+	dst->max = src->max;
+}
+
+/*
+ * hist_percentile - Walk the buckets until pct percent of the values
+ *     have been seen, and return the top of the bucket reached
+ */
+unsigned long long hist_percentile(hist_t *h, double pct)
+{
+    unsigned long long target, seen = 0;
+    int i;
+
+    if (h->count == 0)
+	return 0;
+    target = (unsigned long long)(pct / 100.0 * h->count + 0.5);
+    if (target < 1)
+	target = 1;
+    for (i = 0; i < HIST_BUCKETS; i++) {
+	seen += h->bucket[i];
+	if (seen >= target)
+	    return (hist_top(i) < h->max) ? hist_top(i) : h->max;
+    }
+    return h->max;
+}
+
+/*
+ * hist_index - Bucket of value v. Values below 2*HIST_SUB are their own
+ *     bucket; above that, the HIST_SUB_BITS bits after the leading one
+ *     pick a bucket within the value's power of two.
+ */
+static int hist_index(unsigned long long v)
+{
+    int shift;
+
+    if (v < 2 * HIST_SUB)
+	return (int)v;
+    shift = (63 - __builtin_clzll(v)) - HIST_SUB_BITS;
+    return (shift << HIST_SUB_BITS) + (int)(v >> shift);
+}
+
+/*
+ * hist_top - Largest value that falls in bucket i
+ */
+static unsigned long long hist_top(int i)
+{
+    int shift;
+
+    if (i < 2 * HIST_SUB)
+	return i;
+    shift = (i >> HIST_SUB_BITS) - 1;
+    return (((unsigned long long)(i - (shift << HIST_SUB_BITS)) + 1) << shift) - 1;
+}
@@ -0,0 +1,30 @@
+/*
+ * lathist.h - Log-linear latency histograms for the mdriver -L replay
+ *
+ * Values below 2*HIST_SUB are counted exactly. Above that, each power
+ * of two is split into HIST_SUB equal buckets, so a value is known to
+ * within 1/HIST_SUB (about 3%) of itself, whatever its size, in a
+ * fixed HIST_BUCKETS counters (the scheme of HdrHistogram).
+ */
+#ifndef __LATHIST_H_
+#define __LATHIST_H_
+
+#define HIST_SUB_BITS 5
+#define HIST_SUB      (1 << HIST_SUB_BITS)  /* buckets per power of two */
+#define HIST_BUCKETS  ((64 - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+typedef struct {
+    unsigned long long count;   /* number of values recorded */
+    unsigned long long max;     /* largest value recorded */
+    unsigned long long bucket[HIST_BUCKETS];
+} hist_t;
+
+void hist_clear(hist_t *h);
+void hist_record(hist_t *h, unsigned long long v);
+void hist_merge(hist_t *dst, hist_t *src);
+
+/* Smallest recorded value v such that pct percent of values are <= v,
+   rounded up to the top of its bucket */
+unsigned long long hist_percentile(hist_t *h, double pct);
+
+#endif /* __LATHIST_H_ */
@@ -14,12 +14,21 @@
 #include <string.h>
 #include <assert.h>
 #include <float.h>
+#include <limits.h>
+#include <stddef.h>
 #include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "mm.h"
 #include "memlib.h"
 #include "fsecs.h"
+#include "clock.h"
 #include "config.h"
+#include "trace.h"
+#include "lathist.h"
 
 /**********************
  * Constants and macros
@@ -29,27 +38,62 @@
 #define MAXLINE     1024 /* max string size */
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
+#define MAXPOLICIES   16 /* max number of policies compared with -p */
+#define MAXBACKENDS   16 /* max number of allocators compared with -b */
+#define STREAM_OPS (1<<16) /* requests per chunk of a streamed trace (-s) */
+#define RANGE_LEVELS  16 /* max height of a node in the range skip list */
+#define RANGE_CHUNK (1<<20) /* bytes the range node pool grabs at a time */
 
 /* Returns true if p is ALIGNMENT-byte aligned */
-#define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
+#define IS_ALIGNED(p)  ((((unsigned long)(p)) % ALIGNMENT) == 0)
 
 /****************************** 
  * The key compound data types 
  *****************************/
 
-/* Records the extent of each block's payload */
+/* 
+ * Records the extent of each block's payload. The ranges form a skip
+ * list sorted by lo; a node of height level is linked into the lists
+ * of levels 0 through level-1.
+ */
 typedef struct range_t {
     char *lo;              /* low payload address */
     char *hi;              /* high payload address */
-    struct range_t *next;  /* next list element */
+    int level;             /* number of entries in next */
+    struct range_t *next[1]; /* next element at each level */
 } range_t;
 
-/* Characterizes a single trace operation (allocator request) */
+/* 
+ * State of a trace streamed from its file (-s). A reader thread decodes
+ * the next chunk of requests into one buffer while the other is being
+ * replayed. It also renames each block id to a small slot number that
+ * is reused once the block is freed, so the per-block arrays grow with
+ * the peak number of live blocks rather than with the trace.
+ */
 typedef struct {
-    enum {ALLOC, FREE, REALLOC} type; /* type of request */
-    int index;                        /* index for free() to use later */
-    int size;                         /* byte size of alloc/realloc request */
-} traceop_t;
+    FILE *file;             /* the trace file */
+    int binary;             /* binary trace (see trace.h), else text */
+    long data_off;          /* file offset of the first request */
+    pthread_t reader;       /* thread decoding chunks ahead of the replay */
+    int running;            /* is the reader thread running? */
+    int cur;                /* buffer being replayed, or -1 */
+
+    pthread_mutex_t lock;   /* protects the fields down to stop */
+    pthread_cond_t cond;    /* signalled when a buffer fills or empties */
+    traceop_t *buf[2];      /* the two buffers of decoded requests */
+    int count[2];           /* requests in each buffer, 0 at the end */
+    int full[2];            /* buffer is filled and not yet replayed */
+    int slots[2];           /* slots in use once each buffer was filled */
+    int stop;               /* tells the reader to quit */
+
+    /* Used only by the reader: block id -> slot */
+    int *ids;               /* open-addressed table of ids, -1 if empty */
+    int *id_slots;          /* slot of each id in the table */
+    int id_cap, id_count;   /* table size (a power of 2) and ids in it */
+    int *free_slots;        /* stack of slots given back by frees */
+    int num_free, free_cap;
+    int next_slot;          /* slots handed out so far */
+} stream_t;
 
 /* Holds the information for one trace file*/
 typedef struct {
@@ -60,8 +104,22 @@ typedef struct {
     traceop_t *ops;      /* array of requests */
     char **blocks;       /* array of ptrs returned by malloc/realloc... */
     size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+    void *map;           /* mapping of a binary trace file, or NULL */
+    size_t map_len;      /* length of that mapping */
+    stream_t *stream;    /* reader of a streamed trace, or NULL */
+    int num_slots;       /* length of blocks and block_sizes */
+    int chunk_base;      /* number of the first request in ops... */
+    int chunk_end;       /* ... and one past the last */
 } trace_t;
 
+/* 
+ * The i'th request of a trace. Requests must be taken in order: when i
+ * runs past the requests in memory, the next chunk of a streamed trace
+ * is fetched.
+ */
+#define TRACE_OP(t, i) \
+    ((i) < (t)->chunk_end ? &(t)->ops[(i) - (t)->chunk_base] : next_chunk(t))
+
 /* 
  * Holds the params to the xxx_speed functions, which are timed by fcyc. 
  * This struct is necessary because fcyc accepts only a pointer array
@@ -81,15 +139,27 @@ typedef struct {
 
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
+    double released; /* KB given back to the OS during the util run (always 0 for libc) */
+    hist_t *lat;     /* latency of each request type (-L), or NULL */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t; 
 
+/* One row of the -p and -b comparison tables: a run over all the traces */
+typedef struct {
+    const char *name; /* policy or allocator name */
+    int valid;        /* were all the traces processed correctly? */
+    double util;      /* average space utilization */
+    double kops;      /* throughput over all the traces */
+} summary_t;
+
 /********************
  * Global variables
  *******************/
 int verbose = 0;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
+static int stream_traces = 0; /* stream traces from disk instead of loading them (-s) */
+static int latency = 0; /* time each request and report percentiles (-L) */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
 /* Directory where default tracefiles are found */
@@ -100,6 +170,16 @@ static char *default_tracefiles[] = {
     DEFAULT_TRACEFILES, NULL
 };
 
+/* The allocators linked into the driver (see mm.h) */
+extern const mm_backend_t implicit_backend, explicit_backend, 
+    buddy1_backend;
+static const mm_backend_t *backends[] = {
+    &mm_backend, &implicit_backend, &explicit_backend, &buddy1_backend, NULL
+};
+
+/* The allocator under test, chosen with -b */
+static const mm_backend_t *backend = &mm_backend;
+
 
 /********************* 
  * Function prototypes 
@@ -110,11 +190,26 @@ static int add_range(range_t **ranges, char *lo, int size,
 		     int tracenum, int opnum);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
+static range_t *find_range(range_t *head, char *key, range_t **update);
+static range_t *range_alloc(int level);
+static void range_release(range_t *p);
 
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(char *tracedir, char *filename);
+static int map_trace(trace_t *trace, char *path);
+static int check_op(traceop_t *op, int num_ids);
 static void free_trace(trace_t *trace);
 
+/* These functions stream a trace from its file in chunks */
+static void open_stream(trace_t *trace, char *path);
+static void rewind_trace(trace_t *trace);
+static void prime_trace(void *ptr);
+static traceop_t *next_chunk(trace_t *trace);
+static void stop_stream(stream_t *s);
+static void *stream_reader(void *arg);
+static int stream_fill(stream_t *s, traceop_t *buf);
+static int stream_slot(stream_t *s, traceop_t *op);
+
 /* Routines for evaluating the correctness and speed of libc malloc */
 static int eval_libc_valid(trace_t *trace, int tracenum);
 static void eval_libc_speed(void *ptr);
@@ -124,9 +219,19 @@ static void eval_libc_speed(void *ptr);
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
 static void eval_mm_speed(void *ptr);
+static hist_t *eval_mm_latency(trace_t *trace);
+static void eval_mm_traces(char **tracefiles, int n, stats_t *stats);
+static void eval_mm_policies(char *policies, char **tracefiles, int n);
+static void check_policies(char *policies);
+static void eval_mm_backends(char *names, char **tracefiles, int n);
+static const mm_backend_t *find_backend(const char *name);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printlatency(int n, stats_t *stats);
+static void summarize(const char *name, int n, stats_t *stats, 
+		      summary_t *summary);
+static void printsummaries(char *label, int n, summary_t *summaries);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -150,6 +255,8 @@ int main(int argc, char **argv)
     int team_check = 1;  /* If set, check team structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    char *policies = NULL; /* Placement policies to compare (set by -p) */
+    char *backend_names = NULL; /* Allocators to run or compare (set by -b) */
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -158,7 +265,7 @@ int main(int argc, char **argv)
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:p:b:shvVgalL")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
@@ -178,6 +285,18 @@ int main(int argc, char **argv)
 	    if (tracedir[strlen(tracedir)-1] != '/') 
 		strcat(tracedir, "/"); /* path always ends with "/" */
 	    break;
+	case 'p': /* Compare these placement policies (comma-separated) */
+	    policies = optarg;
+	    break;
+	case 'b': /* Run these allocators (comma-separated, or "all") */
+	    backend_names = optarg;
+	    break;
+	case 's': /* Stream the traces in chunks instead of loading them */
+	    stream_traces = 1;
+	    break;
+	case 'L': /* Report per-request latency percentiles */
+	    latency = 1;
+	    break;
         case 'a': /* Don't check team structure */
             team_check = 0;
             break;
@@ -261,7 +380,7 @@ int main(int argc, char **argv)
 		speed_params.trace = trace;
 		if (verbose > 1)
 		    printf("and performance.\n");
-		libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+		libc_stats[i].secs = fsecs_prep(prime_trace, eval_libc_speed, &speed_params);
 	    }
 	    free_trace(trace);
 	}
@@ -287,6 +406,28 @@ int main(int argc, char **argv)
     /* Initialize the simulated memory system in memlib.c */
     mem_init(); 
 
+    /* 
+     * With -b, the first allocator named replaces mm for the main run,
+     * and if more than one is named they are all compared first.
+     */
+    if (backend_names != NULL) {
+	if (strcmp(backend_names, "all") != 0 && 
+	    strchr(backend_names, ',') == NULL) {
+	    if ((backend = find_backend(backend_names)) == NULL) {
+		printf("ERROR: Unknown allocator %s\n", backend_names);
+		exit(1);
+	    }
+	} else {
+	    eval_mm_backends(backend_names, tracefiles, num_tracefiles);
+	}
+    }
+
+    /* Optionally compare the placement policies given with -p */
+    if (policies != NULL) {
+	check_policies(policies);
+	eval_mm_policies(policies, tracefiles, num_tracefiles);
+    }
+
     /* Evaluate student's mm malloc package using the K-best scheme */
     for (i=0; i < num_tracefiles; i++) {
 	trace = read_trace(tracedir, tracefiles[i]);
@@ -298,18 +439,21 @@ int main(int argc, char **argv)
 	    if (verbose > 1)
 		printf("efficiency, ");
 	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
+	    mm_stats[i].released = mem_released() / 1024.0;
 	    speed_params.trace = trace;
 	    speed_params.ranges = ranges;
 	    if (verbose > 1)
 		printf("and performance.\n");
-	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
+	    mm_stats[i].secs = fsecs_prep(prime_trace, eval_mm_speed, &speed_params);
+	    if (latency)
+		mm_stats[i].lat = eval_mm_latency(trace);
 	}
 	free_trace(trace);
     }
 
     /* Display the mm results in a compact table */
-    if (verbose) {
-	printf("\nResults for mm malloc:\n");
+    if (verbose || latency) {
+	printf("\nResults for %s malloc:\n", backend->name);
 	printresults(num_tracefiles, mm_stats);
 	printf("\n");
     }
@@ -369,9 +513,21 @@ int main(int argc, char **argv)
 /*****************************************************************
  * The following routines manipulate the range list, which keeps 
  * track of the extent of every allocated block payload. We use the 
- * range list to detect any overlapping allocated blocks.
+ * range list to detect any overlapping allocated blocks. It is a
+ * skip list sorted by payload address, so each check or removal
+ * takes O(log n) expected time in the number of live blocks, and its
+ * nodes come from a pool rather than from one malloc per range.
  ****************************************************************/
 
+static range_t *range_free[RANGE_LEVELS]; /* free nodes of each height */
+static char *range_pool;                  /* unused part of the pool... */
+static char *range_pool_end;              /* ... and its end */
+static unsigned range_seed = 2463534242u; /* state for node heights */
+
+/* Bytes in a range node of height level */
+#define RANGE_SIZE(level) \
+    (offsetof(range_t, next) + (level) * sizeof(range_t *))
+
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of 
@@ -382,8 +538,9 @@ static int add_range(range_t **ranges, char *lo, int size,
 		     int tracenum, int opnum)
 {
     char *hi = lo + size - 1;
-    range_t *p;
+    range_t *p, *update[RANGE_LEVELS];
     char msg[MAXLINE];
+    int level;
 
     assert(size > 0);
 
@@ -395,36 +552,48 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of the heap (a region or a mem_map block) */
+    if (!mem_in_heap(lo, hi)) {
 	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
 		lo, hi, mem_heap_lo(), mem_heap_hi());
 	malloc_error(tracenum, opnum, msg);
         return 0;
     }
 
-    /* The payload must not overlap any other payloads */
-    for (p = *ranges;  p != NULL;  p = p->next) {
-        if ((lo >= p->lo && lo <= p-> hi) ||
-            (hi >= p->lo && hi <= p->hi)) {
-	    sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-		    lo, hi, p->lo, p->hi);
-	    malloc_error(tracenum, opnum, msg);
-	    return 0;
-        }
+    /* 
+     * The payload must not overlap any other payloads. The payloads
+     * in the list never overlap each other, so only the last one
+     * starting at or below hi can reach into this one.
+     */
+    if (*ranges == NULL)
+	*ranges = range_alloc(RANGE_LEVELS);
+    p = find_range(*ranges, hi, update);
+    if (p != *ranges && p->hi >= lo) {
+	sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
+		lo, hi, p->lo, p->hi);
+	malloc_error(tracenum, opnum, msg);
+	return 0;
     }
 
     /* 
      * Everything looks OK, so remember the extent of this block 
-     * by creating a range struct and adding it the range list.
+     * by creating a range struct and adding it the range list. No
+     * payload starts in lo..hi, so update[] also brackets lo.
      */
-    if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
-	unix_error("malloc error in add_range");
-    p->next = *ranges;
+    for (level = 1; level < RANGE_LEVELS; level++) {
+	range_seed ^= range_seed << 13;
+	range_seed ^= range_seed >> 17;
+	range_seed ^= range_seed << 5;
+	if (range_seed & 3)      /* each level holds 1/4 of the one below */
+	    break;
+    }
+    p = range_alloc(level);
     p->lo = lo;
     p->hi = hi;
-    *ranges = p;
+    for (level = 0; level < p->level; level++) {
+	p->next[level] = update[level]->next[level];
+	update[level]->next[level] = p;
+    }
     return 1;
 }
 
@@ -434,17 +603,17 @@ static int add_range(range_t **ranges, char *lo, int size,
 static void remove_range(range_t **ranges, char *lo)
 {
     range_t *p;
-    range_t **prevpp = ranges;
-    int size;
-
-    for (p = *ranges;  p != NULL; p = p->next) {
-        if (p->lo == lo) {
-	    *prevpp = p->next;
-            size = p->hi - p->lo + 1;
-            free(p);
-            break;
-        }
-        prevpp = &(p->next);
+    range_t *update[RANGE_LEVELS];
+    int level;
+
+    if (*ranges == NULL || lo == NULL)
+	return;
+    find_range(*ranges, lo - 1, update);
+    p = update[0]->next[0];
+    if (p != NULL && p->lo == lo) {
+	for (level = 0; level < p->level; level++)
+	    update[level]->next[level] = p->next[level];
+	range_release(p);
     }
 }
 
@@ -455,12 +624,68 @@ static void clear_ranges(range_t **ranges)
 {
     range_t *p;
     range_t *pnext;
+    int level;
+
+    if (*ranges == NULL)
+	return;
+    for (p = (*ranges)->next[0];  p != NULL;  p = pnext) {
+        pnext = p->next[0];
+        range_release(p);
+    }
+    for (level = 0; level < RANGE_LEVELS; level++)
+	(*ranges)->next[level] = NULL;
+}
+
+/*
+ * find_range - Return the last range in the list headed by head whose
+ *     lo is at most key, or head if there is none. At each level,
+ *     update[level] is set to the last such range linked at that level.
+ */
+static range_t *find_range(range_t *head, char *key, range_t **update)
+{
+    range_t *p = head;
+    int level;
 
-    for (p = *ranges;  p != NULL;  p = pnext) {
-        pnext = p->next;
-        free(p);
+    for (level = RANGE_LEVELS - 1; level >= 0; level--) {
+	while (p->next[level] != NULL && p->next[level]->lo <= key)
+	    p = p->next[level];
+	update[level] = p;
     }
-    *ranges = NULL;
+    return p;
+}
+
+/*
+ * range_alloc - Get a zeroed range node of height level, reusing a
+ *     freed node of that height or carving one from the pool.
+ */
+static range_t *range_alloc(int level)
+{
+    range_t *p;
+    size_t size = RANGE_SIZE(level);
+
+    if ((p = range_free[level - 1]) != NULL)
+	range_free[level - 1] = p->next[0];
+    else {
+	if (range_pool == NULL || (size_t)(range_pool_end - range_pool) < size) {
+	    if ((range_pool = (char *)malloc(RANGE_CHUNK)) == NULL)
+		unix_error("malloc error in range_alloc");
+	    range_pool_end = range_pool + RANGE_CHUNK;
+	}
+	p = (range_t *)range_pool;
+	range_pool += size;
+    }
+    memset(p, 0, size);
+    p->level = level;
+    return p;
+}
+
+/*
+ * range_release - Put a range node back on the free list for its height
+ */
+static void range_release(range_t *p)
+{
+    p->next[0] = range_free[p->level - 1];
+    range_free[p->level - 1] = p;
 }
 
 
@@ -491,6 +716,15 @@ static trace_t *read_trace(char *tracedir, char *filename)
     /* Read the trace file header */
     strcpy(path, tracedir);
     strcat(path, filename);
+    trace->stream = NULL;
+    if (stream_traces) {
+	open_stream(trace, path);
+	return trace;
+    }
+    if (map_trace(trace, path))
+	return trace;
+    trace->map = NULL;
+    trace->map_len = 0;
     if ((tracefile = fopen(path, "r")) == NULL) {
 	sprintf(msg, "Could not open %s in read_trace", path);
 	unix_error(msg);
@@ -550,22 +784,450 @@ static trace_t *read_trace(char *tracedir, char *filename)
     fclose(tracefile);
     assert(max_index == trace->num_ids - 1);
     assert(trace->num_ops == op_index);
+    trace->num_slots = trace->num_ids;
+    trace->chunk_base = 0;
+    trace->chunk_end = trace->num_ops;
     
     return trace;
 }
 
+/*
+ * map_trace - If path is a binary trace (see trace.h), map it and point
+ *     trace->ops straight at the records in the mapping. Returns 0 if
+ *     the file is not a binary trace, so the caller parses it as text.
+ */
+static int map_trace(trace_t *trace, char *path)
+{
+    int fd, i;
+    uint32_t magic;
+    struct stat st;
+    bintrace_hdr_t *hdr;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+	sprintf(msg, "Could not open %s in read_trace", path);
+	unix_error(msg);
+    }
+    if (read(fd, &magic, sizeof(magic)) != sizeof(magic) || 
+	magic != BINTRACE_MAGIC) {
+	close(fd);
+	return 0;
+    }
+    if (fstat(fd, &st) < 0)
+	unix_error("fstat failed in map_trace");
+    if ((size_t)st.st_size < sizeof(bintrace_hdr_t)) {
+	sprintf(msg, "Truncated binary trace %s", path);
+	app_error(msg);
+    }
+    trace->map_len = st.st_size;
+    trace->map = mmap(NULL, trace->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (trace->map == MAP_FAILED)
+	unix_error("mmap failed in map_trace");
+    close(fd);
+
+    hdr = trace->map;
+    if (hdr->num_ops < 0 || hdr->num_ids < 0) {
+	sprintf(msg, "Bad header in binary trace %s", path);
+	app_error(msg);
+    }
+    if (trace->map_len != sizeof(bintrace_hdr_t) + 
+	(size_t)hdr->num_ops * sizeof(traceop_t)) {
+	sprintf(msg, "Truncated binary trace %s", path);
+	app_error(msg);
+    }
+    trace->sugg_heapsize = hdr->sugg_heapsize;
+    trace->num_ids = hdr->num_ids;
+    trace->num_ops = hdr->num_ops;
+    trace->weight = hdr->weight;
+    trace->ops = (traceop_t *)(hdr + 1);
+    for (i = 0; i < trace->num_ops; i++) {
+	if (!check_op(&trace->ops[i], trace->num_ids)) {
+	    sprintf(msg, "Bad request %d in binary trace %s", i, path);
+	    app_error(msg);
+	}
+    }
+    trace->num_slots = trace->num_ids;
+    trace->chunk_base = 0;
+    trace->chunk_end = trace->num_ops;
+
+    /* Only the per-block arrays are allocated; the requests stay mapped */
+    if ((trace->blocks = 
+	 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
+	unix_error("malloc 3 failed in map_trace");
+    if ((trace->block_sizes = 
+	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
+	unix_error("malloc 4 failed in map_trace");
+    return 1;
+}
+
+/*
+ * check_op - Return 1 if a request read from a binary trace has a known
+ *     type, a block index in [0, num_ids) and a size that is not
+ *     negative. The replay indexes the block arrays with it unchecked.
+ */
+static int check_op(traceop_t *op, int num_ids)
+{
+    return (op->type == ALLOC || op->type == FREE || op->type == REALLOC) &&
+	op->index >= 0 && op->index < num_ids && op->size >= 0;
+}
+
 /*
  * free_trace - Free the trace record and the three arrays it points
  *              to, all of which were allocated in read_trace().
  */
 void free_trace(trace_t *trace)
 {
-    free(trace->ops);         /* free the three arrays... */
+    stream_t *s = trace->stream;
+
+    if (s != NULL) {          /* stop reading a streamed trace... */
+	stop_stream(s);
+	fclose(s->file);
+	free(s->buf[0]);
+	free(s->buf[1]);
+	free(s->ids);
+	free(s->id_slots);
+	free(s->free_slots);
+	pthread_mutex_destroy(&s->lock);
+	pthread_cond_destroy(&s->cond);
+	free(s);
+    }
+    else if (trace->map != NULL) /* or unmap a binary trace's requests... */
+	munmap(trace->map, trace->map_len);
+    else
+	free(trace->ops);     /* or free the three arrays... */
     free(trace->blocks);      
     free(trace->block_sizes);
     free(trace);              /* and the trace record itself... */
 }
 
+/*
+ * open_stream - Open path for streaming (-s) and read its header. No
+ *     requests are read yet; rewind_trace() starts the reader thread
+ *     before each pass over the trace.
+ */
+static void open_stream(trace_t *trace, char *path)
+{
+    stream_t *s;
+    bintrace_hdr_t hdr;
+    uint32_t magic;
+
+    if ((s = (stream_t *)calloc(1, sizeof(stream_t))) == NULL)
+	unix_error("malloc 1 failed in open_stream");
+    if ((s->file = fopen(path, "r")) == NULL) {
+	sprintf(msg, "Could not open %s in open_stream", path);
+	unix_error(msg);
+    }
+    if (fread(&magic, sizeof(magic), 1, s->file) == 1 && 
+	magic == BINTRACE_MAGIC) {
+	rewind(s->file);
+	if (fread(&hdr, sizeof(hdr), 1, s->file) != 1) {
+	    sprintf(msg, "Truncated binary trace %s", path);
+	    app_error(msg);
+	}
+	if (hdr.num_ops < 0 || hdr.num_ids < 0) {
+	    sprintf(msg, "Bad header in binary trace %s", path);
+	    app_error(msg);
+	}
+	trace->sugg_heapsize = hdr.sugg_heapsize;
+	trace->num_ids = hdr.num_ids;
+	trace->num_ops = hdr.num_ops;
+	trace->weight = hdr.weight;
+	s->binary = 1;
+    }
+    else {
+	rewind(s->file);
+	fscanf(s->file, "%d", &(trace->sugg_heapsize)); /* not used */
+	fscanf(s->file, "%d", &(trace->num_ids));     
+	fscanf(s->file, "%d", &(trace->num_ops));     
+	fscanf(s->file, "%d", &(trace->weight));        /* not used */
+    }
+    s->data_off = ftell(s->file);
+
+    /* Two chunks of requests, and a small id table that grows on demand */
+    if ((s->buf[0] = (traceop_t *)malloc(STREAM_OPS * sizeof(traceop_t))) == NULL ||
+	(s->buf[1] = (traceop_t *)malloc(STREAM_OPS * sizeof(traceop_t))) == NULL)
+	unix_error("malloc 2 failed in open_stream");
+    s->id_cap = 1024;
+    s->free_cap = 1024;
+    if ((s->ids = (int *)malloc(s->id_cap * sizeof(int))) == NULL ||
+	(s->id_slots = (int *)malloc(s->id_cap * sizeof(int))) == NULL ||
+	(s->free_slots = (int *)malloc(s->free_cap * sizeof(int))) == NULL)
+	unix_error("malloc 3 failed in open_stream");
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->cur = -1;
+
+    trace->stream = s;
+    trace->map = NULL;
+    trace->map_len = 0;
+    trace->ops = NULL;
+    trace->blocks = NULL;
+    trace->block_sizes = NULL;
+    trace->num_slots = 0;
+    trace->chunk_base = 0;
+    trace->chunk_end = 0;
+}
+
+/*
+ * rewind_trace - Go back to the first request of a streamed trace and
+ *     start decoding it. Does nothing for a trace held in memory.
+ */
+static void rewind_trace(trace_t *trace)
+{
+    stream_t *s = trace->stream;
+
+    if (s == NULL)
+	return;
+    stop_stream(s);
+    if (fseek(s->file, s->data_off, SEEK_SET) < 0)
+	unix_error("fseek failed in rewind_trace");
+    memset(s->ids, -1, s->id_cap * sizeof(int));
+    s->id_count = 0;
+    s->num_free = 0;
+    s->next_slot = 0;
+    s->full[0] = s->full[1] = 0;
+    s->stop = 0;
+    s->cur = -1;
+
+    trace->ops = NULL;
+    trace->chunk_base = 0;
+    trace->chunk_end = 0;
+    if (pthread_create(&s->reader, NULL, stream_reader, s) != 0)
+	unix_error("pthread_create failed in rewind_trace");
+    s->running = 1;
+}
+
+/*
+ * prime_trace - Called by fsecs before each timed pass over the trace:
+ *     rewind it and wait for the first chunk, so that starting the
+ *     reader and decoding that chunk are not counted in the time
+ */
+static void prime_trace(void *ptr)
+{
+    trace_t *trace = ((speed_t *)ptr)->trace;
+
+    rewind_trace(trace);
+    if (trace->stream != NULL && trace->num_ops > 0)
+	next_chunk(trace);
+}
+
+/*
+ * next_chunk - Hand the chunk just replayed back to the reader, wait
+ *     for the next one, and return its first request. Called through
+ *     TRACE_OP when the replay runs off the end of trace->ops.
+ */
+static traceop_t *next_chunk(trace_t *trace)
+{
+    stream_t *s = trace->stream;
+    int b, i;
+
+    if (s == NULL)
+	app_error("Request past the end of the trace in next_chunk");
+    pthread_mutex_lock(&s->lock);
+    if (s->cur >= 0) {
+	s->full[s->cur] = 0;
+	pthread_cond_broadcast(&s->cond);
+    }
+    b = (s->cur < 0) ? 0 : s->cur ^ 1;
+    while (!s->full[b])
+	pthread_cond_wait(&s->cond, &s->lock);
+    pthread_mutex_unlock(&s->lock);
+    if (s->count[b] == 0)
+	app_error("Streamed trace has fewer requests than its header says");
+    s->cur = b;
+
+    /* Make room for any slots the reader handed out in this chunk */
+    if (s->slots[b] > trace->num_slots) {
+	if ((trace->blocks = (char **)realloc(trace->blocks, 
+	     s->slots[b] * sizeof(char *))) == NULL ||
+	    (trace->block_sizes = (size_t *)realloc(trace->block_sizes,
+	     s->slots[b] * sizeof(size_t))) == NULL)
+	    unix_error("realloc failed in next_chunk");
+	for (i = trace->num_slots; i < s->slots[b]; i++) {
+	    trace->blocks[i] = NULL;
+	    trace->block_sizes[i] = 0;
+	}
+	trace->num_slots = s->slots[b];
+    }
+
+    trace->ops = s->buf[b];
+    trace->chunk_base = trace->chunk_end;
+    trace->chunk_end += s->count[b];
+    return &trace->ops[0];
+}
+
+/*
+ * stop_stream - Stop the reader thread of a streamed trace, if any
+ */
+static void stop_stream(stream_t *s)
+{
+    if (!s->running)
+	return;
+    pthread_mutex_lock(&s->lock);
+    s->stop = 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->reader, NULL);
+    s->running = 0;
+}
+
+/*
+ * stream_reader - Reader thread: fill the two buffers in turn, each as
+ *     soon as the replay hands it back. An empty buffer marks the end.
+ */
+static void *stream_reader(void *arg)
+{
+    stream_t *s = (stream_t *)arg;
+    int b = 0, n;
+
+    while (1) {
+	pthread_mutex_lock(&s->lock);
+	while (s->full[b] && !s->stop)
+	    pthread_cond_wait(&s->cond, &s->lock);
+	if (s->stop) {
+	    pthread_mutex_unlock(&s->lock);
+	    return NULL;
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	n = stream_fill(s, s->buf[b]);
+
+	pthread_mutex_lock(&s->lock);
+	s->count[b] = n;
+	s->slots[b] = s->next_slot;
+	s->full[b] = 1;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+	if (n == 0)
+	    return NULL;
+	b ^= 1;
+    }
+}
+
+/*
+ * stream_fill - Decode up to STREAM_OPS requests into buf, with block
+ *     ids renamed to slots. Returns the number decoded, 0 at the end.
+ */
+static int stream_fill(stream_t *s, traceop_t *buf)
+{
+    char type[MAXLINE];
+    int n = 0, i;
+
+    if (s->binary) {
+	n = fread(buf, sizeof(traceop_t), STREAM_OPS, s->file);
+	for (i = 0; i < n; i++)   /* ids are renamed, so any id >= 0 will do */
+	    if (!check_op(&buf[i], INT_MAX))
+		app_error("Bad request in streamed binary trace");
+    }
+    else {
+	while (n < STREAM_OPS && fscanf(s->file, "%s", type) != EOF) {
+	    switch(type[0]) {
+	    case 'a':
+		buf[n].type = ALLOC;
+		fscanf(s->file, "%d %d", &buf[n].index, &buf[n].size);
+		break;
+	    case 'r':
+		buf[n].type = REALLOC;
+		fscanf(s->file, "%d %d", &buf[n].index, &buf[n].size);
+		break;
+	    case 'f':
+		buf[n].type = FREE;
+		buf[n].size = 0;
+		fscanf(s->file, "%d", &buf[n].index);
+		break;
+	    default:
+		printf("Bogus type character (%c) in streamed tracefile\n", 
+		       type[0]);
+		exit(1);
+	    }
+	    n++;
+	}
+    }
+    for (i = 0; i < n; i++)
+	buf[i].index = stream_slot(s, &buf[i]);
+    return n;
+}
+
+/* Home bucket of a block id in the reader's id table */
+#define ID_HASH(s, id) (((unsigned)(id) * 2654435761u) & ((s)->id_cap - 1))
+
+/*
+ * stream_slot - Return the slot for the block named by op. A new block
+ *     takes a slot given back by an earlier free, or a fresh one; a
+ *     free gives its slot back. Reusing a slot is safe because the
+ *     replay runs the requests in the order they were decoded.
+ */
+static int stream_slot(stream_t *s, traceop_t *op)
+{
+    int i, j, k, slot, mask;
+    int *ids, *id_slots, cap;
+
+    /* Keep the table at most half full, rehashing when it doubles */
+    if (2 * (s->id_count + 1) > s->id_cap) {
+	ids = s->ids;
+	id_slots = s->id_slots;
+	cap = s->id_cap;
+	s->id_cap *= 2;
+	if ((s->ids = (int *)malloc(s->id_cap * sizeof(int))) == NULL ||
+	    (s->id_slots = (int *)malloc(s->id_cap * sizeof(int))) == NULL)
+	    unix_error("malloc failed in stream_slot");
+	memset(s->ids, -1, s->id_cap * sizeof(int));
+	for (i = 0; i < cap; i++) {
+	    if (ids[i] < 0)
+		continue;
+	    for (j = ID_HASH(s, ids[i]); s->ids[j] >= 0; j = (j + 1) & (s->id_cap - 1))
+		;
+	    s->ids[j] = ids[i];
+	    s->id_slots[j] = id_slots[i];
+	}
+	free(ids);
+	free(id_slots);
+    }
+    mask = s->id_cap - 1;
+
+    for (i = ID_HASH(s, op->index); s->ids[i] >= 0; i = (i + 1) & mask)
+	if (s->ids[i] == op->index)
+	    break;
+
+    if (op->type != FREE) {
+	if (s->ids[i] >= 0)      /* realloc of a live block */
+	    return s->id_slots[i];
+	if (s->num_free > 0)
+	    slot = s->free_slots[--s->num_free];
+	else
+	    slot = s->next_slot++;
+	s->ids[i] = op->index;
+	s->id_slots[i] = slot;
+	s->id_count++;
+	return slot;
+    }
+
+    if (s->ids[i] < 0) {
+	sprintf(msg, "Free of unknown block id %d in streamed trace", op->index);
+	app_error(msg);
+    }
+    slot = s->id_slots[i];
+    if (s->num_free == s->free_cap) {
+	s->free_cap *= 2;
+	if ((s->free_slots = (int *)realloc(s->free_slots, 
+	     s->free_cap * sizeof(int))) == NULL)
+	    unix_error("realloc failed in stream_slot");
+    }
+    s->free_slots[s->num_free++] = slot;
+
+    /* Delete by shifting back any later entry that probed past i */
+    for (j = (i + 1) & mask; s->ids[j] >= 0; j = (j + 1) & mask) {
+	k = ID_HASH(s, s->ids[j]);
+	if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+	    s->ids[i] = s->ids[j];
+	    s->id_slots[i] = s->id_slots[j];
+	    i = j;
+	}
+    }
+    s->ids[i] = -1;
+    s->id_count--;
+    return slot;
+}
+
 /**********************************************************************
  * The following functions evaluate the correctness, space utilization,
  * and throughput of the libc and mm malloc packages.
@@ -583,28 +1245,31 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
     char *newp;
     char *oldp;
     char *p;
+    traceop_t *op;
     
     /* Reset the heap and free any records in the range list */
     mem_reset_brk();
     clear_ranges(ranges);
+    rewind_trace(trace);
 
     /* Call the mm package's init function */
-    if (mm_init() < 0) {
+    if (backend->init() < 0) {
 	malloc_error(tracenum, 0, "mm_init failed.");
 	return 0;
     }
 
     /* Interpret each operation in the trace in order */
     for (i = 0;  i < trace->num_ops;  i++) {
-	index = trace->ops[i].index;
-	size = trace->ops[i].size;
+	op = TRACE_OP(trace, i);
+	index = op->index;
+	size = op->size;
 
-        switch (trace->ops[i].type) {
+        switch (op->type) {
 
         case ALLOC: /* mm_malloc */
 
 	    /* Call the student's malloc */
-	    if ((p = mm_malloc(size)) == NULL) {
+	    if ((p = backend->malloc(size)) == NULL) {
 		malloc_error(tracenum, i, "mm_malloc failed.");
 		return 0;
 	    }
@@ -633,7 +1298,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    
 	    /* Call the student's realloc */
 	    oldp = trace->blocks[index];
-	    if ((newp = mm_realloc(oldp, size)) == NULL) {
+	    if ((newp = backend->realloc(oldp, size)) == NULL) {
 		malloc_error(tracenum, i, "mm_realloc failed.");
 		return 0;
 	    }
@@ -671,7 +1336,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Remove region from list and call student's free function */
 	    p = trace->blocks[index];
 	    remove_range(ranges, p);
-	    mm_free(p);
+	    backend->free(p);
 	    break;
 
 	default:
@@ -689,10 +1354,10 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   The idea is to remember the high water mark "hwm" of the heap for 
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the 
- *   size of the heap in bytes after running the student's malloc 
- *   package on the trace. Note that our implementation of mem_sbrk() 
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap. 
+ *   peak size of the heap in bytes while running the student's malloc 
+ *   package on the trace. mem_sbrk() lets the package decrement the
+ *   brk pointer, so the final brk can be below the high water mark;
+ *   mem_heap_peak() remembers the high water mark of the heap.
  *   
  */
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
@@ -704,20 +1369,23 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
     int total_size = 0;
     char *p;
     char *newp, *oldp;
+    traceop_t *op;
 
     /* initialize the heap and the mm malloc package */
     mem_reset_brk();
-    if (mm_init() < 0)
+    rewind_trace(trace);
+    if (backend->init() < 0)
 	app_error("mm_init failed in eval_mm_util");
 
     for (i = 0;  i < trace->num_ops;  i++) {
-        switch (trace->ops[i].type) {
+	op = TRACE_OP(trace, i);
+        switch (op->type) {
 
         case ALLOC: /* mm_alloc */
-	    index = trace->ops[i].index;
-	    size = trace->ops[i].size;
+	    index = op->index;
+	    size = op->size;
 
-	    if ((p = mm_malloc(size)) == NULL) 
+	    if ((p = backend->malloc(size)) == NULL) 
 		app_error("mm_malloc failed in eval_mm_util");
 	    
 	    /* Remember region and size */
@@ -734,12 +1402,12 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    break;
 
 	case REALLOC: /* mm_realloc */
-	    index = trace->ops[i].index;
-	    newsize = trace->ops[i].size;
+	    index = op->index;
+	    newsize = op->size;
 	    oldsize = trace->block_sizes[index];
 
 	    oldp = trace->blocks[index];
-	    if ((newp = mm_realloc(oldp,newsize)) == NULL)
+	    if ((newp = backend->realloc(oldp,newsize)) == NULL)
 		app_error("mm_realloc failed in eval_mm_util");
 
 	    /* Remember region and size */
@@ -756,11 +1424,11 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    break;
 
         case FREE: /* mm_free */
-	    index = trace->ops[i].index;
+	    index = op->index;
 	    size = trace->block_sizes[index];
 	    p = trace->blocks[index];
 	    
-	    mm_free(p);
+	    backend->free(p);
 	    
 	    /* Keep track of current total size
 	     * of all allocated blocks */
@@ -774,7 +1442,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
         }
     }
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    return ((double)max_total_size / (double)mem_heap_peak());
 }
 
 
@@ -787,42 +1455,287 @@ static void eval_mm_speed(void *ptr)
     int i, index, size, newsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
+    traceop_t *op;
 
     /* Reset the heap and initialize the mm package */
     mem_reset_brk();
-    if (mm_init() < 0) 
+    if (backend->init() < 0) 
 	app_error("mm_init failed in eval_mm_speed");
 
     /* Interpret each trace request */
-    for (i = 0;  i < trace->num_ops;  i++)
-        switch (trace->ops[i].type) {
+    for (i = 0;  i < trace->num_ops;  i++) {
+	op = TRACE_OP(trace, i);
+        switch (op->type) {
 
         case ALLOC: /* mm_malloc */
-            index = trace->ops[i].index;
-            size = trace->ops[i].size;
-            if ((p = mm_malloc(size)) == NULL)
+            index = op->index;
+            size = op->size;
+            if ((p = backend->malloc(size)) == NULL)
 		app_error("mm_malloc error in eval_mm_speed");
             trace->blocks[index] = p;
             break;
 
 	case REALLOC: /* mm_realloc */
-	    index = trace->ops[i].index;
-            newsize = trace->ops[i].size;
+	    index = op->index;
+            newsize = op->size;
 	    oldp = trace->blocks[index];
-            if ((newp = mm_realloc(oldp,newsize)) == NULL)
+            if ((newp = backend->realloc(oldp,newsize)) == NULL)
 		app_error("mm_realloc error in eval_mm_speed");
             trace->blocks[index] = newp;
             break;
 
         case FREE: /* mm_free */
-            index = trace->ops[i].index;
+            index = op->index;
             block = trace->blocks[index];
-            mm_free(block);
+            backend->free(block);
             break;
 
 	default:
 	    app_error("Nonexistent request type in eval_mm_valid");
         }
+    }
+}
+
+/*
+ * eval_mm_latency - Replay the trace once more, timing each request
+ *    on its own, and return a histogram of the times (in read_counter()
+ *    ticks) for each request type.
+ */
+static hist_t *eval_mm_latency(trace_t *trace)
+{
+    int i, index;
+    unsigned long long t0, t1;
+    hist_t *lat;
+    traceop_t *op;
+
+    if ((lat = (hist_t *)calloc(3, sizeof(hist_t))) == NULL)
+	unix_error("calloc failed in eval_mm_latency");
+
+    mem_reset_brk();
+    rewind_trace(trace);
+    if (backend->init() < 0) 
+	app_error("mm_init failed in eval_mm_latency");
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+	op = TRACE_OP(trace, i);
+	index = op->index;
+        switch (op->type) {
+
+        case ALLOC: /* mm_malloc */
+	    t0 = read_counter();
+	    trace->blocks[index] = backend->malloc(op->size);
+	    t1 = read_counter();
+	    if (trace->blocks[index] == NULL)
+		app_error("mm_malloc error in eval_mm_latency");
+            break;
+
+	case REALLOC: /* mm_realloc */
+	    t0 = read_counter();
+	    trace->blocks[index] = backend->realloc(trace->blocks[index], op->size);
+	    t1 = read_counter();
+	    if (trace->blocks[index] == NULL)
+		app_error("mm_realloc error in eval_mm_latency");
+            break;
+
+        case FREE: /* mm_free */
+	    t0 = read_counter();
+	    backend->free(trace->blocks[index]);
+	    t1 = read_counter();
+            break;
+
+	default:
+	    app_error("Nonexistent request type in eval_mm_latency");
+	    return NULL;
+        }
+	hist_record(&lat[op->type], t1 - t0);
+    }
+    return lat;
+}
+
+/*
+ * eval_mm_traces - Check, measure, and time the allocator under test
+ *    on each trace, filling in one stats_t per trace.
+ */
+static void eval_mm_traces(char **tracefiles, int n, stats_t *stats)
+{
+    int i;
+    trace_t *trace;
+    range_t *ranges = NULL;
+    speed_t speed_params;
+
+    for (i = 0; i < n; i++)
+	free(stats[i].lat);
+    memset(stats, 0, n * sizeof(stats_t));
+    for (i = 0; i < n; i++) {
+	trace = read_trace(tracedir, tracefiles[i]);
+	stats[i].ops = trace->num_ops;
+	stats[i].valid = eval_mm_valid(trace, i, &ranges);
+	if (stats[i].valid) {
+	    stats[i].util = eval_mm_util(trace, i, &ranges);
+	    stats[i].released = mem_released() / 1024.0;
+	    speed_params.trace = trace;
+	    speed_params.ranges = ranges;
+	    stats[i].secs = fsecs_prep(prime_trace, eval_mm_speed, &speed_params);
+	    if (latency)
+		stats[i].lat = eval_mm_latency(trace);
+	}
+	free_trace(trace);
+    }
+}
+
+/*
+ * check_policies - Exit with an error if mm_init rejects any name in
+ *    the comma-separated policy list
+ */
+static void check_policies(char *policies)
+{
+    char *list, *name, *saved;
+
+    if ((saved = getenv("MM_POLICY")) != NULL)
+	saved = strdup(saved);
+    if ((list = strdup(policies)) == NULL)
+	unix_error("strdup failed in check_policies");
+
+    for (name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+	if (setenv("MM_POLICY", name, 1) < 0)
+	    unix_error("setenv failed in check_policies");
+	mem_reset_brk();
+	if (mm_backend.init() < 0) {
+	    printf("ERROR: Unknown placement policy %s\n", name);
+	    exit(1);
+	}
+    }
+
+    if (saved != NULL) {
+	setenv("MM_POLICY", saved, 1);
+	free(saved);
+    } else
+	unsetenv("MM_POLICY");
+    free(list);
+}
+
+/*
+ * eval_mm_policies - Run the traces once for each placement policy in
+ *    the comma-separated list (passed to mm_init through MM_POLICY) and
+ *    print the average utilization and the throughput of each one.
+ *    Only mm.c reads MM_POLICY, so the runs use mm whatever -b selected.
+ */
+static void eval_mm_policies(char *policies, char **tracefiles, int n)
+{
+    char *list, *name, *saved;
+    int num = 0;
+    const mm_backend_t *saved_backend = backend;
+    stats_t *stats;
+    summary_t results[MAXPOLICIES];
+
+    backend = &mm_backend;
+    if ((saved = getenv("MM_POLICY")) != NULL)
+	saved = strdup(saved);
+    if ((list = strdup(policies)) == NULL)
+	unix_error("strdup failed in eval_mm_policies");
+    if ((stats = (stats_t *)calloc(n, sizeof(stats_t))) == NULL)
+	unix_error("stats calloc in eval_mm_policies failed");
+
+    for (name = strtok(list, ","); name != NULL && num < MAXPOLICIES; 
+	 name = strtok(NULL, ",")) {
+	if (setenv("MM_POLICY", name, 1) < 0)
+	    unix_error("setenv failed in eval_mm_policies");
+	if (verbose > 1)
+	    printf("\nTesting mm malloc, policy %s\n", name);
+
+	eval_mm_traces(tracefiles, n, stats);
+	if (verbose) {
+	    printf("\nResults for mm malloc, policy %s:\n", name);
+	    printresults(n, stats);
+	}
+	summarize(name, n, stats, &results[num++]);
+    }
+
+    printf("\nResults by placement policy:\n");
+    printsummaries("policy", num, results);
+
+    /* Leave MM_POLICY as it was for the main run */
+    if (saved != NULL) {
+	setenv("MM_POLICY", saved, 1);
+	free(saved);
+    } else
+	unsetenv("MM_POLICY");
+    backend = saved_backend;
+    free(stats);
+    free(list);
+}
+
+/*
+ * eval_mm_backends - Run the traces once for each allocator in the
+ *    comma-separated list (or every linked allocator for "all") and
+ *    print their utilization and throughput side by side. The first
+ *    allocator named is left selected for the main run.
+ */
+static void eval_mm_backends(char *names, char **tracefiles, int n)
+{
+    char *list, *name;
+    int i, num = 0;
+    int saved_errors = errors;
+    const mm_backend_t *first = NULL, *runs[MAXBACKENDS];
+    stats_t *stats;
+    summary_t results[MAXBACKENDS];
+
+    if (strcmp(names, "all") == 0) {
+	for (i = 0; backends[i] != NULL && num < MAXBACKENDS; i++)
+	    runs[num++] = backends[i];
+    } else {
+	if ((list = strdup(names)) == NULL)
+	    unix_error("strdup failed in eval_mm_backends");
+	for (name = strtok(list, ","); name != NULL && num < MAXBACKENDS; 
+	     name = strtok(NULL, ",")) {
+	    if ((runs[num] = find_backend(name)) == NULL) {
+		printf("ERROR: Unknown allocator %s\n", name);
+		exit(1);
+	    }
+	    num++;
+	}
+	free(list);
+    }
+    if ((stats = (stats_t *)calloc(n, sizeof(stats_t))) == NULL)
+	unix_error("stats calloc in eval_mm_backends failed");
+
+    for (i = 0; i < num; i++) {
+	backend = runs[i];
+	if (first == NULL)
+	    first = backend;
+	if (verbose > 1)
+	    printf("\nTesting %s malloc\n", backend->name);
+
+	/* An allocator that fails a trace must not fail the main run */
+	errors = 0;
+	eval_mm_traces(tracefiles, n, stats);
+	if (verbose) {
+	    printf("\nResults for %s malloc:\n", backend->name);
+	    printresults(n, stats);
+	}
+	summarize(backend->name, n, stats, &results[i]);
+    }
+    errors = saved_errors;
+
+    printf("\nResults by allocator:\n");
+    printsummaries("malloc", num, results);
+
+    backend = first;
+    free(stats);
+}
+
+/*
+ * find_backend - Look up a linked allocator by name
+ */
+static const mm_backend_t *find_backend(const char *name)
+{
+    int i;
+
+    for (i = 0; backends[i] != NULL; i++) {
+	if (strcmp(backends[i]->name, name) == 0)
+	    return backends[i];
+    }
+    return NULL;
 }
 
 /*
@@ -835,30 +1748,33 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 {
     int i, newsize;
     char *p, *newp, *oldp;
+    traceop_t *op;
 
+    rewind_trace(trace);
     for (i = 0;  i < trace->num_ops;  i++) {
-        switch (trace->ops[i].type) {
+	op = TRACE_OP(trace, i);
+        switch (op->type) {
 
         case ALLOC: /* malloc */
-	    if ((p = malloc(trace->ops[i].size)) == NULL) {
+	    if ((p = malloc(op->size)) == NULL) {
 		malloc_error(tracenum, i, "libc malloc failed");
 		unix_error("System message");
 	    }
-	    trace->blocks[trace->ops[i].index] = p;
+	    trace->blocks[op->index] = p;
 	    break;
 
 	case REALLOC: /* realloc */
-            newsize = trace->ops[i].size;
-	    oldp = trace->blocks[trace->ops[i].index];
+            newsize = op->size;
+	    oldp = trace->blocks[op->index];
 	    if ((newp = realloc(oldp, newsize)) == NULL) {
 		malloc_error(tracenum, i, "libc realloc failed");
 		unix_error("System message");
 	    }
-	    trace->blocks[trace->ops[i].index] = newp;
+	    trace->blocks[op->index] = newp;
 	    break;
 	    
         case FREE: /* free */
-	    free(trace->blocks[trace->ops[i].index]);
+	    free(trace->blocks[op->index]);
 	    break;
 
 	default:
@@ -880,20 +1796,22 @@ static void eval_libc_speed(void *ptr)
     int index, size, newsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
+    traceop_t *op;
 
     for (i = 0;  i < trace->num_ops;  i++) {
-        switch (trace->ops[i].type) {
+	op = TRACE_OP(trace, i);
+        switch (op->type) {
         case ALLOC: /* malloc */
-	    index = trace->ops[i].index;
-	    size = trace->ops[i].size;
+	    index = op->index;
+	    size = op->size;
 	    if ((p = malloc(size)) == NULL)
 		unix_error("malloc failed in eval_libc_speed");
 	    trace->blocks[index] = p;
 	    break;
 
 	case REALLOC: /* realloc */
-	    index = trace->ops[i].index;
-	    newsize = trace->ops[i].size;
+	    index = op->index;
+	    newsize = op->size;
 	    oldp = trace->blocks[index];
 	    if ((newp = realloc(oldp, newsize)) == NULL)
 		unix_error("realloc failed in eval_libc_speed\n");
@@ -902,7 +1820,7 @@ static void eval_libc_speed(void *ptr)
 	    break;
 	    
         case FREE: /* free */
-	    index = trace->ops[i].index;
+	    index = op->index;
 	    block = trace->blocks[index];
 	    free(block);
 	    break;
@@ -924,52 +1842,142 @@ static void printresults(int n, stats_t *stats)
     double secs = 0;
     double ops = 0;
     double util = 0;
+    double released = 0;
 
     /* Print the individual results for each trace */
-    printf("%5s%7s %5s%8s%10s%6s\n", 
-	   "trace", " valid", "util", "ops", "secs", "Kops");
+    printf("%5s%7s %5s%8s%10s%6s%8s\n", 
+	   "trace", " valid", "util", "ops", "secs", "Kops", "retKB");
     for (i=0; i < n; i++) {
 	if (stats[i].valid) {
-	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f%8.0f\n", 
 		   i,
 		   "yes",
 		   stats[i].util*100.0,
 		   stats[i].ops,
 		   stats[i].secs,
-		   (stats[i].ops/1e3)/stats[i].secs);
+		   (stats[i].ops/1e3)/stats[i].secs,
+		   stats[i].released);
 	    secs += stats[i].secs;
 	    ops += stats[i].ops;
 	    util += stats[i].util;
+	    released += stats[i].released;
 	}
 	else {
-	    printf("%2d%10s%6s%8s%10s%6s\n", 
+	    printf("%2d%10s%6s%8s%10s%6s%8s\n", 
 		   i,
 		   "no",
 		   "-",
 		   "-",
 		   "-",
+		   "-",
 		   "-");
 	}
     }
 
     /* Print the aggregate results for the set of traces */
     if (errors == 0) {
-	printf("%12s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	printf("%12s%5.0f%%%8.0f%10.6f%6.0f%8.0f\n", 
 	       "Total       ",
 	       (util/n)*100.0,
 	       ops, 
 	       secs,
-	       (ops/1e3)/secs);
+	       (ops/1e3)/secs,
+	       released);
     }
     else {
-	printf("%12s%6s%8s%10s%6s\n", 
+	printf("%12s%6s%8s%10s%6s%8s\n", 
 	       "Total       ",
 	       "-", 
 	       "-", 
 	       "-", 
+	       "-",
 	       "-");
     }
 
+    if (latency)
+	printlatency(n, stats);
+}
+
+/*
+ * printlatency - Print the -L latency percentiles (in ns) of each
+ *     request type, for each trace and over all of them
+ */
+static void printlatency(int n, stats_t *stats)
+{
+    static char *names[] = {"malloc", "free", "realloc"}; /* by op type */
+    static hist_t total[3];
+    double scale = 1e3 / mhz(0);     /* ns per read_counter() tick */
+    hist_t *h;
+    int i, type;
+
+    for (type = 0; type < 3; type++)
+	hist_clear(&total[type]);
+
+    printf("\nLatency in ns:\n");
+    printf("%5s%8s%9s%7s%7s%7s%9s\n", 
+	   "trace", "op", "count", "p50", "p99", "p99.9", "max");
+    for (i = 0; i <= n; i++) {
+	for (type = 0; type < 3; type++) {
+	    if (i < n) {
+		if (!stats[i].valid || stats[i].lat == NULL)
+		    continue;
+		h = &stats[i].lat[type];
+		hist_merge(&total[type], h);
+	    }
+	    else 
+		h = &total[type];
+	    if (h->count == 0)
+		continue;
+	    if (i < n)
+		printf("%2d%11s", i, names[type]);
+	    else
+		printf("%5s%8s", "Total", names[type]);
+	    printf("%9llu%7.0f%7.0f%7.0f%9.0f\n", h->count,
+		   hist_percentile(h, 50.0) * scale,
+		   hist_percentile(h, 99.0) * scale,
+		   hist_percentile(h, 99.9) * scale,
+		   h->max * scale);
+	}
+    }
+}
+
+/*
+ * summarize - Fold the per-trace stats of one run into a table row
+ */
+static void summarize(const char *name, int n, stats_t *stats, 
+		      summary_t *summary)
+{
+    int i;
+    double secs = 0, ops = 0, util = 0;
+
+    summary->name = name;
+    summary->valid = 1;
+    for (i = 0; i < n; i++) {
+	secs += stats[i].secs;
+	ops += stats[i].ops;
+	util += stats[i].util;
+	summary->valid &= stats[i].valid;
+    }
+    summary->util = util / n;
+    summary->kops = (secs > 0) ? (ops / 1e3) / secs : 0;
+}
+
+/*
+ * printsummaries - Print the -p or -b comparison table
+ */
+static void printsummaries(char *label, int n, summary_t *summaries)
+{
+    int i;
+
+    printf("%9s%7s%6s%8s\n", label, " valid", "util", "Kops");
+    for (i = 0; i < n; i++) {
+	if (summaries[i].valid)
+	    printf("%9s%7s%5.0f%%%8.0f\n", summaries[i].name, "yes",
+		   summaries[i].util * 100.0, summaries[i].kops);
+	else
+	    printf("%9s%7s%6s%8s\n", summaries[i].name, "no", "-", "-");
+    }
+    printf("\n");
 }
 
 /* 
@@ -1004,13 +2012,17 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValLs] [-f <file>] [-t <dir>] [-p <policies>] [-b <allocators>]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
+    fprintf(stderr, "\t-b <list>  Run another allocator, or compare several, e.g. mm,buddy1 or all.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-L         Print latency percentiles for each request type.\n");
+    fprintf(stderr, "\t-p <list>  Compare placement policies, e.g. lifo,addr,best,exact.\n");
+    fprintf(stderr, "\t-s         Stream traces from disk in chunks instead of loading them.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
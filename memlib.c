@@ -3,6 +3,7 @@
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
  */
+#define _GNU_SOURCE  /* for mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -10,28 +11,108 @@
 #include <sys/mman.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "memlib.h"
 #include "config.h"
 
+/* 
+ * The heap is modeled as up to MEM_REGIONS independent regions, each
+ * with its own brk pointer. Region 0 is the classic single heap that
+ * mem_sbrk extends; the others are extended with mem_region_sbrk so
+ * that an allocator can give every arena its own contiguous sbrk-like
+ * area. mem_init reserves all of them up front, so their bounds never
+ * change while allocator threads run and mem_region_of can read them
+ * without a lock.
+ *
+ * Each region reserves MAX_HEAP bytes of address space with an
+ * inaccessible mapping. Pages are made accessible (committed) in
+ * COMMIT_CHUNK steps as the brk advances and made inaccessible again
+ * when the brk drops, so only the part of the heap in use costs memory.
+ */
+#define COMMIT_CHUNK (1 << 16)  /* commit granularity, a multiple of the page size */
+
+typedef struct {
+    char *start_brk;  /* points to first byte of region */
+    char *brk;        /* points to last byte of region */
+    char *max_addr;   /* largest legal region address */
+    char *peak_brk;   /* highest brk since the last reset */
+    char *commit_brk; /* end of the accessible part of the region */
+} region_t;
+
+/*
+ * Besides the regions, an allocator can map huge blocks on their own
+ * with mem_map. Live mappings are recorded so that the driver can tell
+ * a payload inside one from a stray pointer, and they count toward the
+ * heap size.
+ */
+typedef struct {
+    char *start;      /* first byte of the mapping */
+    size_t len;       /* length in bytes */
+} mapping_t;
+
 /* private variables */
-static char *mem_start_brk;  /* points to first byte of heap */
-static char *mem_brk;        /* points to last byte of heap */
-static char *mem_max_addr;   /* largest legal heap address */ 
+static region_t regions[MEM_REGIONS];
+static size_t released;  /* bytes given back to the OS since the last reset */
+static mapping_t *maps;  /* live mappings made by mem_map */
+static int nmaps, maps_cap;
+static size_t mapped, mapped_peak; /* bytes in live mappings, and its peak */
+static pthread_mutex_t maps_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void region_init(region_t *r);
+static int region_commit(region_t *r, char *new_brk);
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
-    /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
-	fprintf(stderr, "mem_init_vm: malloc error\n");
+    int i;
+
+    for (i = 0; i < MEM_REGIONS; i++)
+	region_init(&regions[i]);
+}
+
+/*
+ * region_init - reserve the address space that models one region of VM
+ */
+static void region_init(region_t *r)
+{
+    void *p = mmap(NULL, MAX_HEAP, PROT_NONE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (p == MAP_FAILED) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
 	exit(1);
     }
 
-    mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
-    mem_brk = mem_start_brk;                  /* heap is empty initially */
+    r->start_brk = (char *)p;
+    r->max_addr = r->start_brk + MAX_HEAP;  /* max legal heap address */
+    r->brk = r->start_brk;                  /* heap is empty initially */
+    r->peak_brk = r->start_brk;
+    r->commit_brk = r->start_brk;           /* nothing is accessible yet */
+}
+
+/*
+ * region_commit - make [start_brk, new_brk) accessible, rounding up to
+ *    COMMIT_CHUNK, and make everything above that inaccessible again.
+ *    Returns -1 if the pages could not be committed.
+ */
+static int region_commit(region_t *r, char *new_brk)
+{
+    size_t off = ((size_t)(new_brk - r->start_brk) + COMMIT_CHUNK - 1) & ~(size_t)(COMMIT_CHUNK - 1);
+    char *new_commit = r->start_brk + off;
+
+    if (new_commit > r->max_addr)
+	new_commit = r->max_addr;
+    if (new_commit > r->commit_brk) {
+	if (mprotect(r->commit_brk, new_commit - r->commit_brk, PROT_READ | PROT_WRITE) < 0)
+	    return -1;
+    } else if (new_commit < r->commit_brk) {
+	mprotect(new_commit, r->commit_brk - new_commit, PROT_NONE);
+    }
+    r->commit_brk = new_commit;
+    return 0;
 }
 
 /* 
@@ -39,41 +120,232 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-    free(mem_start_brk);
+    int i;
+
+    for (i = 0; i < MEM_REGIONS; i++) {
+	if (regions[i].start_brk != NULL)
+	    munmap(regions[i].start_brk, MAX_HEAP);
+	regions[i].start_brk = regions[i].brk = regions[i].max_addr = NULL;
+	regions[i].peak_brk = regions[i].commit_brk = NULL;
+    }
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointers to make an empty heap
  */
 void mem_reset_brk()
 {
-    mem_brk = mem_start_brk;
+    int i;
+
+    for (i = 0; i < MEM_REGIONS; i++)
+	regions[i].brk = regions[i].peak_brk = regions[i].start_brk;
+    released = 0;
+
+    /* Mappings left over from the previous run belong to no one now */
+    pthread_mutex_lock(&maps_lock);
+    for (i = 0; i < nmaps; i++)
+	munmap(maps[i].start, maps[i].len);
+    nmaps = 0;
+    mapped = mapped_peak = 0;
+    pthread_mutex_unlock(&maps_lock);
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area. A
+ *    negative incr shrinks the heap and returns the old brk.
+ */
+void *mem_sbrk(intptr_t incr) 
+{
+    return mem_region_sbrk(0, incr);
+}
+
+/*
+ * mem_region_sbrk - extend region by incr bytes. Regions are
+ *    independent: each one has its own brk and never grows into
+ *    another. A negative incr shrinks the region and decommits the
+ *    whole pages above the new brk. Callers must serialize calls on
+ *    the same region. incr is checked against the room left in the
+ *    region before it is added to the brk, so no increment can wrap
+ *    the pointer.
  */
-void *mem_sbrk(int incr) 
+void *mem_region_sbrk(int region, intptr_t incr)
 {
-    char *old_brk = mem_brk;
+    region_t *r = &regions[region];
+    char *old_brk;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    old_brk = r->brk;
+    if (incr < r->start_brk - r->brk) {
+	errno = EINVAL;
+	fprintf(stderr, "ERROR: mem_sbrk failed. Shrinking below the heap start...\n");
+	return (void *)-1;
+    }
+    if (incr > r->max_addr - r->brk ||
+	((r->brk + incr) > r->commit_brk && region_commit(r, r->brk + incr) < 0)) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
-    mem_brk += incr;
+    r->brk += incr;
+    if (r->brk > r->peak_brk)
+	r->peak_brk = r->brk;
+    if (incr < 0) {
+	mem_decommit(r->brk, (size_t)-incr);
+	region_commit(r, r->brk);
+    }
     return (void *)old_brk;
 }
 
+/*
+ * mem_decommit - give the whole pages inside [addr, addr+len) back to
+ *    the OS. Their contents are lost (they read back as zero), but the
+ *    addresses stay valid. Returns the number of bytes decommitted.
+ */
+size_t mem_decommit(void *addr, size_t len)
+{
+    size_t pagesize = mem_pagesize();
+    char *lo = (char *)(((unsigned long)addr + pagesize - 1) & ~(pagesize - 1));
+    char *hi = (char *)(((unsigned long)addr + len) & ~(pagesize - 1));
+
+    if (hi <= lo)
+	return 0;
+    if (madvise(lo, hi - lo, MADV_DONTNEED) < 0)
+	return 0;
+    __atomic_fetch_add(&released, (size_t)(hi - lo), __ATOMIC_RELAXED);
+    return (size_t)(hi - lo);
+}
+
+/*
+ * mem_map - map len bytes (a multiple of the page size) outside the
+ *    regions, for a huge block. Returns (void *)-1 on failure.
+ */
+void *mem_map(size_t len)
+{
+    mapping_t *m;
+    void *p;
+
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+	fprintf(stderr, "ERROR: mem_map failed. Ran out of memory...\n");
+	return (void *)-1;
+    }
+
+    pthread_mutex_lock(&maps_lock);
+    if (nmaps == maps_cap) {
+	maps_cap = maps_cap ? 2 * maps_cap : 64;
+	if ((m = realloc(maps, maps_cap * sizeof(mapping_t))) == NULL) {
+	    fprintf(stderr, "mem_map: realloc error\n");
+	    exit(1);
+	}
+	maps = m;
+    }
+    maps[nmaps].start = p;
+    maps[nmaps].len = len;
+    nmaps++;
+    mapped += len;
+    if (mapped > mapped_peak)
+	mapped_peak = mapped;
+    pthread_mutex_unlock(&maps_lock);
+    return p;
+}
+
+/*
+ * mem_remap - resize the mapping at p from old_len to new_len bytes,
+ *    moving it if needed. Returns the new start or (void *)-1.
+ */
+void *mem_remap(void *p, size_t old_len, size_t new_len)
+{
+    void *q;
+    int i;
+
+    q = mremap(p, old_len, new_len, MREMAP_MAYMOVE);
+    if (q == MAP_FAILED) {
+	fprintf(stderr, "ERROR: mem_remap failed. Ran out of memory...\n");
+	return (void *)-1;
+    }
+
+    pthread_mutex_lock(&maps_lock);
+    for (i = 0; i < nmaps; i++) {
+	if (maps[i].start == (char *)p) {
+	    maps[i].start = q;
+	    maps[i].len = new_len;
+	    break;
+	}
+    }
+    mapped += new_len - old_len;
+    if (mapped > mapped_peak)
+	mapped_peak = mapped;
+    if (new_len < old_len)
+	__atomic_fetch_add(&released, old_len - new_len, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&maps_lock);
+    return q;
+}
+
+/*
+ * mem_unmap - unmap a mapping made by mem_map
+ */
+void mem_unmap(void *p, size_t len)
+{
+    int i;
+
+    pthread_mutex_lock(&maps_lock);
+    for (i = 0; i < nmaps; i++) {
+	if (maps[i].start == (char *)p) {
+	    maps[i] = maps[--nmaps];
+	    break;
+	}
+    }
+    mapped -= len;
+    __atomic_fetch_add(&released, len, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&maps_lock);
+    munmap(p, len);
+}
+
+/*
+ * mem_in_heap - return 1 if [lo, hi] lies inside the used part of one
+ *    region or inside one live mapping, 0 otherwise
+ */
+int mem_in_heap(void *lo, void *hi)
+{
+    int i, found = 0;
+
+    for (i = 0; i < MEM_REGIONS; i++)
+	if ((char *)lo >= regions[i].start_brk && (char *)hi < regions[i].brk)
+	    return 1;
+
+    pthread_mutex_lock(&maps_lock);
+    for (i = 0; i < nmaps && !found; i++)
+	if ((char *)lo >= maps[i].start && (char *)hi < maps[i].start + maps[i].len)
+	    found = 1;
+    pthread_mutex_unlock(&maps_lock);
+    return found;
+}
+
+/*
+ * mem_region_of - return the region that contains address p, or -1
+ */
+int mem_region_of(void *p)
+{
+    int i;
+
+    for (i = 0; i < MEM_REGIONS; i++)
+	if ((char *)p >= regions[i].start_brk && (char *)p < regions[i].max_addr)
+	    return i;
+    return -1;
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
 void *mem_heap_lo()
 {
-    return (void *)mem_start_brk;
+    char *lo = regions[0].start_brk;
+    int i;
+
+    for (i = 1; i < MEM_REGIONS; i++)
+	if (regions[i].brk != regions[i].start_brk && regions[i].start_brk < lo)
+	    lo = regions[i].start_brk;
+    return (void *)lo;
 }
 
 /* 
@@ -81,15 +353,51 @@ void *mem_heap_lo()
  */
 void *mem_heap_hi()
 {
-    return (void *)(mem_brk - 1);
+    char *hi = regions[0].brk;
+    int i;
+
+    for (i = 1; i < MEM_REGIONS; i++)
+	if (regions[i].brk > hi)
+	    hi = regions[i].brk;
+    return (void *)(hi - 1);
 }
 
 /*
- * mem_heapsize() - returns the heap size in bytes
+ * mem_heapsize() - returns the heap size in bytes, summed over regions
+ *    and live mappings
  */
 size_t mem_heapsize() 
 {
-    return (size_t)(mem_brk - mem_start_brk);
+    size_t size = 0;
+    int i;
+
+    for (i = 0; i < MEM_REGIONS; i++)
+	size += (size_t)(regions[i].brk - regions[i].start_brk);
+    return size + mapped;
+}
+
+/*
+ * mem_heap_peak() - returns the largest heap size since the last reset,
+ *    summed over regions, plus the peak of the live mappings. Unlike
+ *    mem_heapsize, this does not drop when the heap is shrunk.
+ */
+size_t mem_heap_peak()
+{
+    size_t size = 0;
+    int i;
+
+    for (i = 0; i < MEM_REGIONS; i++)
+	size += (size_t)(regions[i].peak_brk - regions[i].start_brk);
+    return size + mapped_peak;
+}
+
+/*
+ * mem_released() - returns the bytes given back to the OS by shrinking
+ *    the heap or by mem_decommit since the last reset
+ */
+size_t mem_released()
+{
+    return __atomic_load_n(&released, __ATOMIC_RELAXED);
 }
 
 /*
@@ -1,11 +1,23 @@
 #include <unistd.h>
+#include <stdint.h>
+
+#define MEM_REGIONS 8  /* max number of independent heap regions */
 
 void mem_init(void);               
 void mem_deinit(void);
-void *mem_sbrk(int incr);
+void *mem_sbrk(intptr_t incr);
+void *mem_region_sbrk(int region, intptr_t incr);
+int mem_region_of(void *p);
+void *mem_map(size_t len);
+void *mem_remap(void *p, size_t old_len, size_t new_len);
+void mem_unmap(void *p, size_t len);
+int mem_in_heap(void *lo, void *hi);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
+size_t mem_heap_peak(void);
+size_t mem_decommit(void *addr, size_t len);
+size_t mem_released(void);
 size_t mem_pagesize(void);
 
@@ -13,9 +13,12 @@
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "mm.h"
 #include "memlib.h"
+#include "sizeclass.h"
 
 
 team_t team = {
@@ -33,153 +36,784 @@ team_t team = {
 
 
 
-//정렬 기준, 64비트 시스템은 보통 시작주소를 8바이트의 배수가 되도록 정렬함.
-// #define ALIGNMENT 8
-
-// #define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~0x7) 
-// // size를 가까운 8의 배수로 올림처리 함. 메모리 블록의 크기가 항상 8바이트의 배수로 정렬되게 하는역할
-// // 0x7은 111이므로 and연산을 통해서  마지막 3비트가 존재했다면 올림처리가 되면서 8의 배수로 설정 되는 것이다.
-
-// // 자료형의 크기를 정렬된 크기로 계산하여 저장한 값. 위에 ALIGN매크로 사용해서 정렬된 크기로 맞춰줌.
-// #define SIZE_T_SIZE (ALIGN(sizeof(size_t)))
+//정렬 기준, x86-64는 malloc이 돌려주는 주소를 16바이트의 배수가 되도록 정렬함.
+// 헤더와 푸터는 8바이트 워드, 블록 크기와 페이로드 시작은 16의 배수.
 
 // 가용 리스트 조작을 위한 기본 상수 및 매크로 정의
-#define WSIZE 4 // 워드나 헤더,푸터
-#define DSIZE 8 // 더블워드
+#define WSIZE 8 // 워드나 헤더,푸터
+#define DSIZE 16 // 더블워드, 정렬 단위
 #define CHUNKSIZE (1<<12) //초기 가용 블록과 힙 확장을 위한 기본 크기
+#define TRIM_THRESHOLD  (1<<17) // 힙 끝의 가용 블록이 이보다 크면 brk를 줄여서 OS에 돌려줌
+#define TRIM_KEEP       (1<<16) // 줄일 때 남겨둘 크기. 바로 다시 늘리지 않도록 넉넉하게
+#define DECOMMIT_MIN    (1<<16) // 해제된 부분이 이만큼의 페이지에 걸치면 그 페이지들을 OS에 돌려줌(decommit)
+#define MMAP_THRESHOLD  (1<<20) // 이 크기 이상 요청은 힙 밖에 블록마다 따로 매핑. MM_MMAP_THRESHOLD 환경변수로 바꿀 수 있음
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))
+#define MIN(x, y) ((x) < (y)? (x) : (y))
+
+#define PACK(size, alloc) ((size_t)(size) | (alloc)) // 블록의 크기(16바이트 정렬된값)와 할당상태(1비트)를 하나의 값으로 저장하기 위해 사용됨. 헤더와 푸터에 이 정보를 넣음.
 
-#define PACK(size, alloc) ((size) | (alloc)) // 블록의 크기(8바이트 정렬된값)와 할당상태(1비트)를 하나의 값으로 저장하기 위해 사용됨. 헤더와 푸터에 이 정보를 넣음.
+typedef size_t word_t; // 헤더, 푸터 한 워드. 64비트라 블록 크기도 4GB에 막히지 않음.
 
-#define GET(p)  (*(unsigned int*)(p)) // 포인터를 사용해 메모리의 특정 위치에 값을 읽어온다. // 일반포인터 p를 unsigned int 포인터로 변환 하는 작업.
-//역참조(dereference) 연산을 통해 p가 가리키는 메모리 위치에 있는 값을 읽는다. 이 값은 unsigned int로 처리
-#define PUT(p, val)  (*(unsigned int*)(p) = (val)) // 얘는 값을 써 넣는다.
+#define GET(p)  (*(word_t *)(p)) // 포인터를 사용해 메모리의 특정 위치에 값을 읽어온다. // 일반포인터 p를 word_t 포인터로 변환 하는 작업.
+//역참조(dereference) 연산을 통해 p가 가리키는 메모리 위치에 있는 값을 읽는다.
+#define PUT(p, val)  (*(word_t *)(p) = (val)) // 얘는 값을 써 넣는다.
 
-#define GET_SIZE(p)  (GET(p) & ~0x7) //~0x7은 1111 1000임.그래서 마지막 3비트만 버리는 용도. // 블록 전체 크기
+#define GET_SIZE(p)  (GET(p) & ~(word_t)0x7) //~0x7은 ...1111 1000임.그래서 마지막 3비트만 버리는 용도. // 블록 전체 크기
 #define GET_ALLOC(p)  (GET(p) & 0x1) //마지막 1비트만 가져오는 용도.
 
+// 할당된 블록은 푸터가 없다. 대신 헤더의 두 번째 비트에 앞블럭이 할당됐는지를 적어둔다.
+// 이 비트는 앞블럭 주인이 바꾸므로 헤더는 put_header로 이 비트를 지키면서 써야 한다.
+#define PREV_ALLOC  0x2
+#define GET_PREV_ALLOC(p)  (GET_ATOMIC(p) & PREV_ALLOC) // 앞블럭의 할당상태
+
 //block ptr = 실제 데이터를 저장하는 위치를 가리키는 포인터
 #define HDRP(bp)    ((char*)(bp) - WSIZE) // bp보다 1워드 앞에 헤더포인트가 있음.!
-#define FTRP(bp)    ((char*)(bp) + GET_SIZE(HDRP(bp)) - DSIZE) // GET_SIZE(HDRP(bp))는 헤더와 푸터를 포함한 전체 블록크기(헤더,페이로드,푸터)를 의미함.
+#define FTRP(bp)    ((char*)(bp) + GET_SIZE(HDRP(bp)) - DSIZE) // GET_SIZE(HDRP(bp))는 헤더와 푸터를 포함한 전체 블록크기(헤더,페이로드,푸터)를 의미함. 가용 블록에만 있음.
 
 #define NEXT_BLKP(bp)    ((char*)(bp) + GET_SIZE((char*)(bp) - WSIZE)) 
 // 헤더의 위치 계산해서, 헤더에서 블록의 전체 크기를 읽어온다. 다음 블럭의 시작 주소 계산
 #define PREV_BLKP(bp)    ((char*)(bp) - GET_SIZE((char*)(bp) - DSIZE)) 
 // 이전 블럭의 푸터 위치 계산해서 전 블록의 전체 크기 읽어온다. 그다음 현재 위치에서 전 블록 크기 빼면 전 블럭의 시작 주소로 감.
-#define FREE_PTR(power)  (*(void **)((char *)(free_listp) + ((power - 4) * WSIZE)))  // 사이즈에 맞는 가용블록 찾기. // 시작이 2의 4승이니까 
-#define PREV_PTR(bp)     (*(void **)((char*)(bp) + WSIZE))
-#define NEXT_PTR(bp)     (*(void **)(bp))
+#define NEXT_PTR(bp)     (*(void **)(bp)) // 스레드 캐시, remote_frees 스택의 링크. 다른 아레나 블록도 섞이니 진짜 포인터.
+
+// 가용 리스트 링크는 아레나 시작(base)부터의 32비트 오프셋이라 64비트에서도 두 링크가 8바이트에 들어간다.
+// 영역 하나가 MAX_HEAP(4GB) 이하라 오프셋은 32비트에 들어가고, base에는 패딩 워드가 있어 오프셋 0은 NULL로 쓴다.
+#define LINK_SIZE        4
+#define OFF_TO_PTR(a, off)  ((off) ? (void *)((a)->base + (off)) : NULL)
+#define PTR_TO_OFF(a, bp)   ((bp) ? (unsigned int)((char *)(bp) - (a)->base) : 0)
+#define FREE_OFF(a, idx) (((unsigned int *)(a)->free_listp)[idx]) // 아레나 a의 idx번째 가용 리스트 머리
+#define NEXT_OFF(bp)     (((unsigned int *)(bp))[0])
+#define PREV_OFF(bp)     (((unsigned int *)(bp))[1])
+#define FREE_PTR(a, idx) OFF_TO_PTR(a, FREE_OFF(a, idx))
+#define NEXT_FREE(a, bp) OFF_TO_PTR(a, NEXT_OFF(bp))
+#define PREV_FREE(a, bp) OFF_TO_PTR(a, PREV_OFF(bp))
+#define HEADS_SIZE       ((FREE_LIST_NUMS * LINK_SIZE + DSIZE - 1) & ~(DSIZE - 1)) // 프롤로그 안 리스트 머리들 자리
+
+// 큰 가용 블록 트리 : TREE_MIN 이상인 가용 블록은 리스트 대신 아레나마다 하나인 레드블랙 트리에 넣는다.
+// 키는 (크기, 주소)라 모두 다르고, 가장 왼쪽부터 찾으면 크기가 같을 때 주소가 낮은 블록이 나오는 best fit.
+// 노드 링크도 오프셋이고 페이로드 앞 16바이트에 있어서 decommit(bp + DSIZE부터)에 걸리지 않는다.
+#define TREE_MIN         (1 << 12)
+#if TREE_MIN != 1 << (SC_FL_MAX + 1) // 리스트 구간은 트리 바로 아래에서 끝나야 함. gensc.c의 FL_MAX와 맞출 것.
+#error "TREE_MIN must be 2^(SC_FL_MAX+1)"
+#endif
+#define T_LEFT(bp)       (((unsigned int *)(bp))[0])
+#define T_RIGHT(bp)      (((unsigned int *)(bp))[1])
+#define T_PARENT(bp)     (((unsigned int *)(bp))[2])
+#define T_RED(bp)        (((unsigned int *)(bp))[3])
+#define T_L(a, bp)       ((char *)OFF_TO_PTR(a, T_LEFT(bp)))
+#define T_R(a, bp)       ((char *)OFF_TO_PTR(a, T_RIGHT(bp)))
+#define T_P(a, bp)       ((char *)OFF_TO_PTR(a, T_PARENT(bp)))
+#define T_ROOT(a)        ((char *)OFF_TO_PTR(a, (a)->tree_root))
+
+
+// TLSF식 2단계 크기 구간 : 1단계(fl)는 2의 몇승인지, 2단계(sl)는 그 구간을 SL_COUNT개로 똑같이 나눈 것.
+// 리스트 (fl, sl)에는 2^fl + sl * 2^(fl - SL_LOG2) 이상, 다음 sl 구간 미만 크기의 블록이 들어간다.
+// 구간 값과 sc_index는 gensc가 만든 sizeclass.h에 있다. 바꾸려면 gensc.c를 고치고 make sizeclass.h.
+#define SL_LOG2         SC_SL_LOG2
+#define SL_COUNT        SC_SL_COUNT
+#define FL_MIN          SC_FL_MIN   // 2^4부터 나누지만 최소 블록이 32라 fl 4 리스트는 늘 비어있음
+#define FL_MAX          SC_FL_MAX   // 2^12(4KB) 이상은 트리에 넣으니 리스트는 fl 11까지만 있음
+#define FL_COUNT        (FL_MAX - FL_MIN + 1)
+#define FREE_LIST_NUMS  SC_NUM
+#define LIST_IDX(fl, sl)  (((fl) - FL_MIN) * SL_COUNT + (sl))
+
+// 배치 정책 : 가용 리스트에서 어떤 블록을 고를지. MM_POLICY 환경변수(lifo, addr, best, exact)로 고른다.
+#define POLICY_LIFO   0 // 리스트 맨 앞에 넣고, 맞는 첫 블록을 씀 (기본)
+#define POLICY_ADDR   1 // 리스트를 주소 순으로 유지하고, 맞는 첫 블록(= 가장 낮은 주소)을 씀
+#define POLICY_BEST   2 // 요청 크기의 구간부터 맞는 블록을 BEST_FIT_K개까지 보고 가장 작은 것
+#define POLICY_EXACT  3 // 요청 크기의 구간에서 크기가 똑같은 블록을 BEST_FIT_K개까지 찾아보고, 없으면 맞는 첫 블록
+#define POLICY_COUNT  4
+#define BEST_FIT_K    8
+
+// 여러 스레드가 힙을 같이 쓰기 위한 상태 비트와 원자적 접근
+#define BUSY  0x4 // 헤더의 세 번째 비트. 가용 블록을 어떤 스레드가 차지(claim)해서 리스트에서 빼거나 고치는 중이라는 표시
+#define GET_ATOMIC(p)       __atomic_load_n((word_t *)(p), __ATOMIC_ACQUIRE)   // 다른 스레드가 바꿀 수 있는 헤더 읽기
+#define PUT_ATOMIC(p, val)  __atomic_store_n((word_t *)(p), (val), __ATOMIC_RELEASE) // 헤더 쓰기
+
+// 큰 블록 : 할당된 블록 헤더에 BUSY 비트가 같이 서 있으면 힙 밖에 따로 매핑한 블록이다.
+// 매핑 맨 앞 DSIZE 안에 헤더가 있고(크기 = 매핑 길이), 병합이나 가용 리스트와는 상관없다.
+#define HUGE  BUSY
+#define IS_HUGE(bp)  ((GET(HDRP(bp)) & (0x1 | HUGE)) == (0x1 | HUGE))
+
+// 경계 락 : 블록 경계(앞블럭 푸터 + 뒷블럭 헤더)마다 주소를 해시해서 락 하나를 고른다.
+#define TAG_LOCKS    256
+#define TAG_LOCK(hp) (&tag_locks[((unsigned long)(hp) >> 4) & (TAG_LOCKS - 1)]) // 헤더와 바로 앞 푸터는 같은 16바이트 칸이라 같은 락
+#define LIST_LOCK(a, fl) (&(a)->list_locks[(fl) - FL_MIN]) // 같은 fl의 SL_COUNT개 리스트와 비트맵 한 줄을 같이 지킴
+#define SPIN_LIMIT   64 // 이만큼 돌아도 못 잡으면 CPU를 양보함
 
-#define FREE_LIST_NUMS  20
+// 스레드 캐시(tcache) : 작은 블록은 스레드마다 따로 가진 bin에서 락 없이 주고받는다.
+#define TCACHE_MAX_SIZE  512   // 이 크기(헤더 포함 블록 크기) 이하만 스레드 캐시를 거침
+#define TCACHE_BINS      (TCACHE_MAX_SIZE / DSIZE - 1) // 32, 48, ... 512 바이트마다 bin 하나
+#define TCACHE_FILL      16    // bin 하나에 담아둘 수 있는 최대 블록 수
+#define TCACHE_BATCH     8     // 중앙 가용 리스트와 한 번에 주고받는 블록 수
+#define TC_IDX(size)     ((size) / DSIZE - 2) // 블록 크기 -> bin 번호
+
+// 지연 병합(MM_DEFER=0이면 끔) : 스레드 캐시보다 크고 QUICK_MAX 이하인 블록은 해제해도 바로 병합하지 않고
+// 아레나의 크기별 quick 리스트에 할당 상태 그대로 넣어둔다. 같은 크기 요청은 거기서 바로 꺼내 쓰고,
+// 맞는 가용 블록이 없거나 quick 리스트에 QUICK_LIMIT 바이트가 넘게 쌓이면 한꺼번에 병합해서 가용 리스트로 돌려준다.
+#define QUICK_MAX        (1 << 12)
+#define QUICK_BINS       ((QUICK_MAX - TCACHE_MAX_SIZE) / DSIZE) // 528, 544, ... 4096 바이트마다 리스트 하나
+#define QUICK_IDX(size)  (((size) - TCACHE_MAX_SIZE) / DSIZE - 1)
+#define QUICK_LIMIT      (1 << 18)
+#define IS_QUICK(size)   (defer && (size) > TCACHE_MAX_SIZE && (size) <= QUICK_MAX)
+
+typedef int spin_t; // 0이면 풀림, 1이면 잠김
+
+// 슬랩 : SLAB_MAX 바이트 이하의 작은 요청은 페이지 하나를 같은 크기 칸(slot)으로 잘라서 준다.
+// 칸에는 헤더, 푸터가 없고 비어있는지는 페이지 머리의 비트맵으로만 안다.
+// 슬랩 페이지 자체는 페이로드가 페이지 경계에 맞춰진 보통의 할당 블록이라 이웃 블록 입장에선 그냥 할당된 블록.
+#define SLAB_PAGE_SHIFT  12
+#define SLAB_PAGE        (1 << SLAB_PAGE_SHIFT) // 4KB
+#define SLAB_MAX         256  // 이 크기(페이로드) 이하만 슬랩에서
+#define SLAB_CLASSES     (SLAB_MAX / DSIZE) // 16, 32, ... 256 바이트 칸
+#define SLAB_CLASS(size) ((size) / DSIZE - 1)
+#define SLOT_SIZE(req)   (DSIZE * (((req) + DSIZE - 1) / DSIZE)) // 요청 크기 -> 칸 크기
+#define SLAB_MAP_WORDS   (SLAB_PAGE / DSIZE / 32) // 칸 비트맵, 가장 작은 칸 기준
+#define SLAB_PAGES_MAX   (1 << 13) // 아레나마다 슬랩 페이지를 표시할 수 있는 범위(페이지 수), 32MB
+#define SLAB_OFFSET      ((sizeof(slab_t) + DSIZE - 1) & ~(DSIZE - 1)) // 페이지 안 첫 칸의 위치
+
+typedef struct slab {
+    struct slab *next;                   // 같은 크기 칸의 빈칸 있는 페이지 리스트
+    struct slab *prev;
+    unsigned int slot_size;              // 칸 크기 (페이로드만)
+    unsigned int nslots;                 // 페이지 안 칸 수
+    unsigned int nfree;                  // 빈칸 수
+    unsigned int free_map[SLAB_MAP_WORDS]; // 비트 i가 1이면 i번째 칸이 빈칸
+} slab_t;
+
+typedef struct {
+    spin_t lock;                         // 이 크기의 partial 리스트와 그 페이지들의 비트맵을 지킴
+    slab_t *partial;                     // 빈칸이 하나라도 있는 페이지들
+} slab_class_t;
+
+// 할당된 블록은 헤더 뒤 전부가 페이로드라 같은 크기의 슬랩 칸보다 8바이트 더 담는다.
+// 그래서 블록과 칸은 같은 bin에 섞지 않고, 칸은 칸 크기별 bin에 따로 모은다.
+typedef struct {
+    void *bins[TCACHE_BINS];            // 블록 크기별 캐시 블록 스택, NEXT_PTR로 연결
+    unsigned char counts[TCACHE_BINS];  // bin마다 들어있는 블록 수
+    void *slab_bins[SLAB_CLASSES];      // 칸 크기별 캐시 칸 스택
+    unsigned char slab_counts[SLAB_CLASSES];
+    unsigned gen;                       // 이 캐시를 채울 때의 힙 세대
+} tcache_t;
+
+// 재할당 예약 : realloc으로 커진 블록 바로 뒤에 차지된 가용 블록(예약)을 남겨두고, 다음에 또 커지면 바로 흡수한다.
+// 예약 크기는 이번에 커진 만큼에서 시작해서 예약을 다 쓰고 또 커질 때마다 두 배가 된다.
+// 힙이 모자라면(find_fit 실패) 예약을 모두 가용 리스트로 돌려준다.
+#define RESERVE_SLOTS  8          // 아레나마다 잡아둘 수 있는 예약 수, 넘치면 오래된 것부터 돌려줌
+#define RESERVE_MAX    (1 << 16)  // 예약 하나의 최대 크기
+
+// 아레나 : 자기만의 가용 리스트, 락, memlib 영역(sbrk)을 가진 독립된 힙. 스레드마다 하나씩 배정됨.
+#define MAX_ARENAS    MEM_REGIONS // 아레나 하나가 memlib 영역 하나를 씀
+#define ARENA_BY_CPU  0 // 1이면 스레드가 처음 돌던 CPU 번호로, 0이면 돌아가면서(round-robin) 아레나를 배정
+
+typedef struct {
+    char *free_listp;                   // 이 아레나의 가용 리스트 머리들이 있는 프롤로그의 bp
+    spin_t list_locks[FL_COUNT];        // fl 하나(리스트 SL_COUNT개)마다 하나
+    unsigned int fl_bitmap;             // 비트 fl : 그 fl에 비어있지 않은 리스트가 있음
+    unsigned int sl_bitmap[FL_COUNT];   // 비트 sl : 리스트 (fl, sl)이 비어있지 않음
+    spin_t top_lock;                    // 이 아레나의 에필로그(힙 끝)를 늘릴 때
+    int region;                         // memlib 영역 번호 (= 아레나 번호)
+    int ready;                          // 프롤로그를 만들었는지
+    void *remote_frees;                 // 다른 스레드가 해제한 블록 스택(NEXT_PTR로 연결). 락 없이 CAS로 넣고, 주인이 통째로 가져감.
+    size_t remote_pushed;               // remote_frees에 들어온 블록 수
+    size_t remote_drained;              // 그중 주인이 리스트에 돌려놓은 블록 수
+    char *base;                         // 영역의 시작 주소, 슬랩 페이지 번호를 셀 때 기준
+    slab_class_t slab_classes[SLAB_CLASSES];
+    slab_t *slab_empty;                 // 칸이 다 비어서 아무 크기로나 다시 쓸 수 있는 페이지들
+    spin_t slab_empty_lock;
+    unsigned int slab_map[SLAB_PAGES_MAX / 32]; // 비트 i가 1이면 base부터 i번째 페이지가 슬랩 페이지
+    void *reserves[RESERVE_SLOTS];      // 재할당 예약 블록들(차지된 상태, 리스트에 없음). 빈 자리는 NULL
+    int reserve_next;                   // 자리가 없을 때 다음에 비울 자리
+    spin_t reserve_lock;
+    unsigned int tree_root;             // 큰 가용 블록 트리의 루트 오프셋, 비었으면 0
+    spin_t tree_lock;                   // 트리의 모든 노드 링크와 색
+    void *quick[QUICK_BINS];            // 지연 병합 중인 블록(할당 상태 그대로) 스택들, 크기별로 NEXT_PTR로 연결
+    size_t quick_bytes;                 // quick 리스트에 쌓인 바이트 수
+    spin_t quick_lock;                  // quick 리스트들과 quick_bytes
+} arena_t;
 
 int mm_init(void);
-static void *extend_heap(size_t words);
+static int arena_init(arena_t *a);
+static arena_t *arena_get(void);
+static arena_t *arena_of(void *bp);
+static void *extend_heap(arena_t *a, size_t words);
 void *mm_malloc(size_t req_size);
-static void *find_fit(size_t alloc_size);
-static void place(void *bp, size_t alloc_size);
+static void *find_fit(arena_t *a, size_t alloc_size);
+static void *pick_block(arena_t *a, unsigned int idx, size_t alloc_size);
+static void place(arena_t *a, void *bp, size_t alloc_size);
+static void shrink_block(arena_t *a, void *bp, size_t alloc_size);
+static size_t absorb_next(void *bp, void *next);
+static int realloc_in_place(arena_t *a, void *bp, size_t alloc_size);
+static void reserve_split(arena_t *a, void *bp, size_t alloc_size, size_t reserve);
+static int reserve_take(arena_t *a, void *bp);
+static void reserve_put(arena_t *a, void *bp);
+static int reserve_release(arena_t *a);
 void mm_free(void *bp);
-static void *coalesce(void *bp);
+static void *coalesce(arena_t *a, void *bp);
 void *mm_realloc(void *old_bp, size_t req_size);
-static void remove_free_block(void *bp, size_t size);    // 가용 리스트에서 제거
-static void add_free_block(void *bp, size_t size);       // 가용 리스트에 추가
-size_t find_next_power(size_t size);
+static void remove_free_block(arena_t *a, void *bp, size_t size);    // 가용 리스트에서 제거
+static void add_free_block(arena_t *a, void *bp, size_t size);       // 가용 리스트에 추가
+static void unlink_free_block(arena_t *a, void *bp, unsigned int fl, unsigned int sl);
+static int tree_less(char *x, char *y);
+static void tree_replace(arena_t *a, char *u, char *v);
+static void tree_rotate_left(arena_t *a, char *x);
+static void tree_rotate_right(arena_t *a, char *x);
+static void tree_insert(arena_t *a, char *z);
+static void tree_remove(arena_t *a, char *z);
+static void *tree_find(arena_t *a, size_t alloc_size);
+static void size_class(size_t size, unsigned int *fl, unsigned int *sl);
+static size_t adjust_size(size_t req_size);
+static void *malloc_block(arena_t *a, size_t alloc_size);
+static void free_block(void *bp);
+static void release_block(arena_t *a, void *bp);
+static size_t trim_top(arena_t *a, void *bp, size_t size);
+static void *huge_alloc(size_t req_size);
+static void *huge_realloc(void *bp, size_t req_size);
+static void huge_free(void *bp);
+static void remote_free_push(arena_t *a, void *bp);
+static void remote_free_drain(arena_t *a);
+void mm_thread_flush(void);
+void mm_remote_stats(size_t *pushed, size_t *drained);
+static void free_local(arena_t *a, void *bp);
+static void quick_push(arena_t *a, void *bp, size_t size);
+static void *quick_pop(arena_t *a, size_t size);
+static int quick_flush(arena_t *a);
+static slab_t *slab_of(void *bp);
+static void *slab_alloc(arena_t *a, size_t slot_size);
+static void slab_free(arena_t *a, slab_t *slab, void *bp);
+static slab_t *slab_page_new(arena_t *a);
+static int claim_block(void *bp);
+static void put_header(void *hp, word_t val);
+static void spin_lock(spin_t *lock);
+static void spin_unlock(spin_t *lock);
+static tcache_t *tcache_get(void);
+static void *tcache_refill(tcache_t *tc, size_t alloc_size);
+static void *tcache_slab_refill(tcache_t *tc, size_t slot_size);
+static void tcache_drain(void **bin, unsigned char *count, int n);
+static void tcache_flush(void *arg);
+static void tcache_init(void);
+
+/*
+ * 동시성 규칙
+ *  - 가용 리스트 (fl, sl)의 링크와 sl_bitmap[fl], fl_bitmap의 fl 비트는 그 아레나의 LIST_LOCK(a, fl)을
+ *    잡고만 바꾼다. 비트맵은 락 없이 읽어도 되는 힌트이고, 락을 잡은 뒤 리스트를 다시 확인한다.
+ *  - 큰 가용 블록 트리는 통째로 그 아레나의 tree_lock 하나로 지킨다. tree_root도 락 없이 읽으면 힌트일 뿐이다.
+ *  - 가용 블록(헤더가 할당 0, BUSY 0)을 리스트에서 빼거나 크기를 바꾸려면 먼저 claim_block으로
+ *    헤더에 BUSY를 CAS로 세워 차지해야 한다. 차지에 실패하면 다른 스레드가 가져간 것이니 건드리지 않는다.
+ *  - 블록 경계의 푸터와 뒷블럭 헤더의 PREV_ALLOC 비트는 그 경계의 tag 락을 잡고 쓴다.
+ *    앞블럭 병합은 이 락을 잡은 채로 PREV_ALLOC을 보고, 앞블럭이 할당되지 않았을 때만
+ *    푸터를 읽고 앞블럭을 차지해야 그 사이에 앞블럭이 바뀌지 않는다.
+ *  - 헤더의 다른 비트는 그 블록을 가진(차지한) 스레드만 바꾸고, PREV_ALLOC은 앞블럭 쪽이
+ *    바꾸므로 헤더 쓰기는 모두 원자적 RMW(put_header, CAS)로 한다.
+ *  - 한 번에 락은 하나만 잡으므로 락 순서 때문에 데드락이 생기지 않는다.
+ *  - 힙 끝(에필로그)은 그 아레나의 top_lock을 잡은 스레드만 늘린다.
+ *  - 블록은 항상 자기 주소가 속한 아레나의 리스트로만 돌아간다. 병합도 같은 영역 안에서만 일어난다.
+ *  - 다른 아레나의 블록을 해제하면 그 아레나의 remote_frees 스택에 넣기만 한다(락 없음).
+ *    스택의 블록은 할당 상태 그대로라 이웃이 병합해가지 못하고, 주인 스레드가 malloc할 때 한꺼번에 돌려놓는다.
+ *  - 슬랩 페이지의 칸 비트맵과 partial 리스트는 그 크기의 slab_classes[].lock을 잡고만 바꾼다.
+ *    다 빈 페이지는 클래스 락을 놓은 뒤 slab_empty_lock을 잡고 slab_empty로 옮긴다.
+ */
+static spin_t tag_locks[TAG_LOCKS]; // 경계 락은 주소로 고르니 아레나가 달라도 같이 씀
+
+static arena_t arenas[MAX_ARENAS];
+static int narenas;                 // 쓸 아레나 개수, mm_init에서 정함
+static size_t mmap_threshold;       // 이 크기 이상 요청은 huge_alloc, mm_init에서 정함
+static int policy;                  // 배치 정책, mm_init에서 정함
+static int defer;                   // 지연 병합을 하는지, mm_init에서 정함
+static const char *policy_names[POLICY_COUNT] = { "lifo", "addr", "best", "exact" };
+static int next_arena;              // round-robin 배정용
+static spin_t arena_lock;           // 아레나를 처음 만들 때
+static __thread arena_t *my_arena;  // 이 스레드에 배정된 아레나
+static __thread unsigned my_arena_gen; // 배정받을 때의 힙 세대
 
-static char *free_listp;    // 가용 리스트의 맨 앞 블록의 bp
+static unsigned heap_gen;               // mm_init 할 때마다 증가, 이전 힙을 가리키는 캐시를 버리는 데 사용
+static __thread tcache_t tcache;        // 스레드마다 하나씩 있는 캐시
+static pthread_key_t tcache_key;        // 스레드가 끝날 때 캐시를 비우기 위한 키
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
 
 //최초 가용 블록으로 힙 생성하기.
+// 아레나 0만 바로 만들고, 나머지는 스레드가 처음 배정될 때 만든다.
 int mm_init(void)
 {
-    if ((free_listp = mem_sbrk((FREE_LIST_NUMS + 4) * WSIZE)) == (void *)-1) // 새로 할당된 힙 영역의 시작 주소를 저장하고 가리킴.
+    char *env;
+    int i;
+
+    narenas = sysconf(_SC_NPROCESSORS_ONLN); // 기본은 CPU 개수만큼, MM_ARENAS 환경변수로 바꿀 수 있음
+    if ((env = getenv("MM_ARENAS")) != NULL)
+        narenas = atoi(env);
+    if (narenas < 1)
+        narenas = 1;
+    if (narenas > MAX_ARENAS)
+        narenas = MAX_ARENAS;
+    mmap_threshold = MMAP_THRESHOLD;
+    if ((env = getenv("MM_MMAP_THRESHOLD")) != NULL && atol(env) > SLAB_MAX) // 슬랩 크기까지는 항상 힙에서
+        mmap_threshold = atol(env);
+    defer = (env = getenv("MM_DEFER")) == NULL || atoi(env) != 0; // 기본은 지연 병합, MM_DEFER=0이면 바로 병합
+    policy = POLICY_LIFO;
+    if ((env = getenv("MM_POLICY")) != NULL) {
+        for (i = 0; i < POLICY_COUNT && strcmp(env, policy_names[i]) != 0; i++)
+            ;
+        if (i == POLICY_COUNT) // 모르는 이름이면 실패. 조용히 lifo로 돌리면 정책 비교가 틀어짐.
+            return -1;
+        policy = i;
+    }
+
+    for (i = 0; i < MAX_ARENAS; i++) {
+        memset(&arenas[i], 0, sizeof(arena_t));
+        arenas[i].region = i;
+    }
+    next_arena = 0;
+    if (arena_init(&arenas[0]) < 0)
+        return -1;
+
+    pthread_once(&tcache_once, tcache_init);
+    heap_gen++; // 모든 스레드 캐시와 아레나 배정이 이전 힙을 버리게 함.
+    return 0;
+}
+
+// 아레나 a의 영역에 프롤로그, 가용 리스트 머리, 에필로그, 첫 가용 블록을 만든다.
+static int arena_init(arena_t *a)
+{
+    char *free_listp;
+    void *bp;
+
+    if ((free_listp = mem_region_sbrk(a->region, HEADS_SIZE + 4 * WSIZE)) == (void *)-1) // 새로 할당된 힙 영역의 시작 주소를 저장하고 가리킴.
     //mem_sbrk가 메모리를 할당하고 할당된 메모리 영역의 시작 주소를 반환하는 애임. 반환값이 -1이면 메모리 확장에 실패한것.
         return -1;
     PUT(free_listp, 0); // 첫부분에 0을 넣음. 이부분은 나중에 필요하지 않은 패딩 공간, 정렬을 맞추기 위해 필요하다.
-    PUT(free_listp + (1*WSIZE), PACK((FREE_LIST_NUMS + 2) * WSIZE, 1)); // 두번째 워드 위치에 블록 크기 8 바이트와 할당 상태를 저장함. 이부분이 프롤로그 블록의 헤더임. 힙의 시작을 표시
-    for (int i = 0; i < FREE_LIST_NUMS; i++) {
-        PREV_PTR(free_listp + ((i+2)*WSIZE)) = NULL;
-    }
-    PUT(free_listp + ((FREE_LIST_NUMS + 2) * WSIZE), PACK((FREE_LIST_NUMS + 2) * WSIZE, 1)); // 두번째 워드 위치에 블록 크기 8 바이트와 할당 상태를 저장함. 이부분이 프롤로그 블록의 헤더임. 힙의 시작을 표시
-    PUT(free_listp + ((FREE_LIST_NUMS + 3) * WSIZE), PACK(0, 1)); // 마지막 워드 위치에 블록 크기 0과 할당 상태 저장. 에필로그 블록. 힙의 끝을 나타내는 역할
+    PUT(free_listp + (1*WSIZE), PACK(HEADS_SIZE + DSIZE, 1)); // 두번째 워드 위치에 프롤로그 블록의 헤더. 리스트 머리들이 이 블록의 페이로드. 힙의 시작을 표시
+    memset(free_listp + DSIZE, 0, HEADS_SIZE); // 리스트 머리(오프셋) 자리, 이전 힙의 값이 남아있지 않게 비운다.
+    PUT(free_listp + DSIZE + HEADS_SIZE, PACK(HEADS_SIZE + DSIZE, 1)); // 프롤로그 블록의 푸터
+    PUT(free_listp + DSIZE + HEADS_SIZE + WSIZE, PACK(0, PREV_ALLOC | 1)); // 마지막 워드 위치에 블록 크기 0과 할당 상태 저장. 에필로그 블록. 힙의 끝을 나타내는 역할. 앞블럭(프롤로그)은 할당됨.
     
-    free_listp += 2* WSIZE; // 이동 전에는 프롤로그 블록의 헤더를 가리키고 있다가 후에는 프롤로그 블록 다음에 올 첫번째 실제 가용 블록의 시작 주소를 가리키게 됨.
+    a->base = free_listp;
+    a->free_listp = free_listp + DSIZE; // 이동 전에는 프롤로그 블록의 헤더를 가리키고 있다가 후에는 프롤로그 블록의 페이로드(리스트 머리들)를 가리키게 됨.
 
-    if (extend_heap(7) == NULL) // 
+    if ((bp = extend_heap(a, 7)) == NULL) // extend_heap은 차지한 상태의 블록을 돌려주므로 직접 리스트에 넣어야 함.
         return -1;
+    release_block(a, bp);
 
-    if (extend_heap(CHUNKSIZE/WSIZE) == NULL) // 초기 힙 확장 크기 2의 12승 / 4 = 2의 10승 개의 워드 크기만큼 확장하겠다. 
+    if ((bp = extend_heap(a, CHUNKSIZE/WSIZE)) == NULL) // 초기 힙 확장 크기 2의 12승 / 4 = 2의 10승 개의 워드 크기만큼 확장하겠다. 
         return -1;
+    release_block(a, bp);
+
+    __atomic_store_n(&a->ready, 1, __ATOMIC_RELEASE);
     return 0;
 }
 
-size_t find_next_power(size_t size) // 수정해야함.
+// 지금 스레드의 아레나. 처음이면(또는 mm_init 이후 처음이면) 하나를 배정하고 필요하면 만든다.
+static arena_t *arena_get(void)
 {
-    size_t power = 4; // 최소 16이니까  
-    size_t power_of_2 = 16; 
+    arena_t *a;
+    int idx;
+
+    if (my_arena != NULL && my_arena_gen == heap_gen)
+        return my_arena;
 
-    if ( size == 16 ) {
-        return power;
+#if ARENA_BY_CPU
+    idx = sched_getcpu();
+    if (idx < 0)
+        idx = 0;
+    idx %= narenas;
+#else
+    idx = __atomic_fetch_add(&next_arena, 1, __ATOMIC_RELAXED) % narenas;
+#endif
+    a = &arenas[idx];
+    if (!__atomic_load_n(&a->ready, __ATOMIC_ACQUIRE)) {
+        spin_lock(&arena_lock);
+        if (!a->ready && arena_init(a) < 0)
+            a = &arenas[0]; // 새 영역을 못 만들면 아레나 0을 같이 씀
+        spin_unlock(&arena_lock);
     }
+    my_arena = a;
+    my_arena_gen = heap_gen;
+    return a;
+}
+
+// 블록 주소가 속한 memlib 영역으로 주인 아레나를 찾는다.
+static arena_t *arena_of(void *bp)
+{
+    return &arenas[mem_region_of(bp)];
+}
+
+// 블록 크기가 들어갈 리스트 (fl, sl)을 구함. 크기에 상관없이 clz 한 번으로 계산.
+static void size_class(size_t size, unsigned int *fl, unsigned int *sl)
+{
+    unsigned int idx = sc_index(size);
 
-    while ( power_of_2 < size ) { // 여기 고치기.
-        power_of_2 <<= 1;
-        power++;
+    *fl = FL_MIN + (idx >> SL_LOG2);
+    *sl = idx & (SL_COUNT - 1);
+}
+
+static void add_free_block(arena_t *a, void *bp, size_t size) // 가용 리스트에 추가, root 변경
+{
+    unsigned int fl, sl, idx, off, prev, next;
+
+    if (size >= TREE_MIN) {
+        spin_lock(&a->tree_lock);
+        tree_insert(a, bp);
+        spin_unlock(&a->tree_lock);
+        return;
+    }
+    size_class(size, &fl, &sl);
+    idx = LIST_IDX(fl, sl);
+    off = PTR_TO_OFF(a, bp);
+    spin_lock(LIST_LOCK(a, fl));
+    prev = 0;
+    next = FREE_OFF(a, idx);
+    if (policy == POLICY_ADDR) { // 주소 순 : 자기보다 뒤에 있는 첫 블록 앞에 넣음. 오프셋 순서가 곧 주소 순서.
+        while (next != 0 && next < off) {
+            prev = next;
+            next = NEXT_OFF(OFF_TO_PTR(a, next));
+        }
     }
-    if (power >= (FREE_LIST_NUMS + 3 )){
-        power = FREE_LIST_NUMS + 3;
+    if (next != 0) { // 뒤에 블록이 있으면
+        PREV_OFF(OFF_TO_PTR(a, next)) = off;
     }
-    return power;
+    NEXT_OFF(bp) = next; 
+    PREV_OFF(bp) = prev;
+    if (prev != 0)
+        NEXT_OFF(OFF_TO_PTR(a, prev)) = off;
+    else
+        FREE_OFF(a, idx) = off;
+    __atomic_fetch_or(&a->sl_bitmap[fl - FL_MIN], 1U << sl, __ATOMIC_RELAXED);
+    __atomic_fetch_or(&a->fl_bitmap, 1U << fl, __ATOMIC_RELAXED);
+    spin_unlock(LIST_LOCK(a, fl));
 }
 
-static void add_free_block(void *bp, size_t size) // 가용 리스트에 추가, root 변경
+static void remove_free_block(arena_t *a, void *bp, size_t size) // 가용 리스트에서 제거, 앞 뒤 리스트 연결
 {
-    size_t power = find_next_power(size); // 사이즈에 가까운 2의 몇승인지 찾기. 
+    unsigned int fl, sl;
 
-    if (FREE_PTR(power) != NULL) { // 이미 루트 값이 있으면
-        PREV_PTR(FREE_PTR(power)) = bp;
+    if (size >= TREE_MIN) {
+        spin_lock(&a->tree_lock);
+        tree_remove(a, bp);
+        spin_unlock(&a->tree_lock);
+        return;
     }
-    NEXT_PTR(bp) = FREE_PTR(power); 
-    PREV_PTR(bp) = NULL;
-    FREE_PTR(power) = bp;
+    size_class(size, &fl, &sl);
+    spin_lock(LIST_LOCK(a, fl));
+    unlink_free_block(a, bp, fl, sl);
+    spin_unlock(LIST_LOCK(a, fl));
+}
+
+// 리스트 (fl, sl)에서 bp를 빼는 실제 작업. LIST_LOCK(a, fl)을 잡은 상태에서 불러야 함.
+static void unlink_free_block(arena_t *a, void *bp, unsigned int fl, unsigned int sl)
+{
+    unsigned int idx = LIST_IDX(fl, sl);
 
+    if ( bp == FREE_PTR(a, idx) ) { // bp가 가용 리스트의 첫 번째 블록일 때
+        if ( NEXT_FREE(a, bp) != NULL) {
+            PREV_OFF(NEXT_FREE(a, bp)) = 0;
+        }
+        FREE_OFF(a, idx) = NEXT_OFF(bp); 
+        if (FREE_OFF(a, idx) == 0) { // 리스트가 비면 비트맵에서도 지움
+            if (__atomic_and_fetch(&a->sl_bitmap[fl - FL_MIN], ~(1U << sl), __ATOMIC_RELAXED) == 0)
+                __atomic_fetch_and(&a->fl_bitmap, ~(1U << fl), __ATOMIC_RELAXED);
+        }
+
+    } else if (NEXT_FREE(a, bp) != NULL) { // bp가 가용리스트 중간 블럭일 때
+        PREV_OFF(NEXT_FREE(a, bp)) = PREV_OFF(bp);
+        NEXT_OFF(PREV_FREE(a, bp)) = NEXT_OFF(bp);
+
+    } else if (NEXT_FREE(a, bp) == NULL) { // bp가 가용리스트 끝 블록일 때
+        NEXT_OFF(PREV_FREE(a, bp)) = 0;
+
+    }
+    PREV_OFF(bp) = 0; // 초기화
+    NEXT_OFF(bp) = 0; // 초기화
 }
 
-static void remove_free_block(void *bp, size_t size) // 가용 리스트에서 제거, 앞 뒤 리스트 연결
+// 트리에서 x가 y보다 앞인지. 크기 순, 크기가 같으면 주소 순이라 모든 노드의 키가 다르다.
+static int tree_less(char *x, char *y)
 {
-    size_t power = find_next_power(size); // 사이즈에 가까운 2의 몇승인지 찾기.
+    size_t xs = GET_SIZE(HDRP(x)), ys = GET_SIZE(HDRP(y));
+
+    return xs < ys || (xs == ys && x < y);
+}
+
+// u 자리(부모의 자식 링크)에 v를 놓음. v는 NULL이어도 됨. u의 링크는 그대로 둔다.
+static void tree_replace(arena_t *a, char *u, char *v)
+{
+    char *p = T_P(a, u);
+
+    if (p == NULL)
+        a->tree_root = PTR_TO_OFF(a, v);
+    else if (T_L(a, p) == u)
+        T_LEFT(p) = PTR_TO_OFF(a, v);
+    else
+        T_RIGHT(p) = PTR_TO_OFF(a, v);
+    if (v != NULL)
+        T_PARENT(v) = T_PARENT(u);
+}
 
-    if ( bp == FREE_PTR(power) ) { // bp가 가용 리스트의 첫 번째 블록일 때
-        if ( NEXT_PTR(bp) != NULL) {
-            PREV_PTR(NEXT_PTR(bp)) = NULL;
+static void tree_rotate_left(arena_t *a, char *x)
+{
+    char *y = T_R(a, x);
+
+    T_RIGHT(x) = T_LEFT(y);
+    if (T_LEFT(y))
+        T_PARENT(T_L(a, y)) = PTR_TO_OFF(a, x);
+    tree_replace(a, x, y);
+    T_LEFT(y) = PTR_TO_OFF(a, x);
+    T_PARENT(x) = PTR_TO_OFF(a, y);
+}
+
+static void tree_rotate_right(arena_t *a, char *x)
+{
+    char *y = T_L(a, x);
+
+    T_LEFT(x) = T_RIGHT(y);
+    if (T_RIGHT(y))
+        T_PARENT(T_R(a, y)) = PTR_TO_OFF(a, x);
+    tree_replace(a, x, y);
+    T_RIGHT(y) = PTR_TO_OFF(a, x);
+    T_PARENT(x) = PTR_TO_OFF(a, y);
+}
+
+// 가용 블록 z를 트리에 넣음. tree_lock을 잡고 불러야 함.
+static void tree_insert(arena_t *a, char *z)
+{
+    char *x = T_ROOT(a), *p = NULL, *g, *u;
+
+    while (x != NULL) {
+        p = x;
+        x = tree_less(z, x) ? T_L(a, x) : T_R(a, x);
+    }
+    T_LEFT(z) = T_RIGHT(z) = 0;
+    T_PARENT(z) = PTR_TO_OFF(a, p);
+    T_RED(z) = 1;
+    if (p == NULL)
+        a->tree_root = PTR_TO_OFF(a, z);
+    else if (tree_less(z, p))
+        T_LEFT(p) = PTR_TO_OFF(a, z);
+    else
+        T_RIGHT(p) = PTR_TO_OFF(a, z);
+
+    // 빨강이 연달아 오면 색을 바꾸거나 회전해서 맞춤.
+    while ((p = T_P(a, z)) != NULL && T_RED(p)) {
+        g = T_P(a, p); // 부모가 빨강이면 루트가 아니니 조부모가 있음
+        if (p == T_L(a, g)) {
+            u = T_R(a, g);
+            if (u != NULL && T_RED(u)) {
+                T_RED(p) = T_RED(u) = 0;
+                T_RED(g) = 1;
+                z = g;
+                continue;
+            }
+            if (z == T_R(a, p)) {
+                tree_rotate_left(a, p);
+                z = p;
+                p = T_P(a, z);
+            }
+            T_RED(p) = 0;
+            T_RED(g) = 1;
+            tree_rotate_right(a, g);
+        } else {
+            u = T_L(a, g);
+            if (u != NULL && T_RED(u)) {
+                T_RED(p) = T_RED(u) = 0;
+                T_RED(g) = 1;
+                z = g;
+                continue;
+            }
+            if (z == T_L(a, p)) {
+                tree_rotate_right(a, p);
+                z = p;
+                p = T_P(a, z);
+            }
+            T_RED(p) = 0;
+            T_RED(g) = 1;
+            tree_rotate_left(a, g);
         }
-        FREE_PTR(power) = NEXT_PTR(bp); 
+    }
+    T_RED(T_ROOT(a)) = 0;
+}
 
-    } else if (NEXT_PTR(bp) != NULL) { // bp가 가용리스트 중간 블럭일 때
-        PREV_PTR(NEXT_PTR(bp)) = PREV_PTR(bp);
-        NEXT_PTR(PREV_PTR(bp)) = NEXT_PTR(bp);
+// 트리에 있는 블록 z를 뺌. tree_lock을 잡고 불러야 함.
+static void tree_remove(arena_t *a, char *z)
+{
+    char *y, *x, *xp, *w;
+    int removed_red = T_RED(z);
 
-    } else if (NEXT_PTR(bp) == NULL) { // bp가 가용리스트 끝 블록일 때
-        NEXT_PTR(PREV_PTR(bp)) = NULL;
+    // x는 빠진 자리에 올라온 노드(NULL일 수 있음), xp는 그 부모.
+    if (T_LEFT(z) == 0 || T_RIGHT(z) == 0) {
+        x = (T_LEFT(z) == 0) ? T_R(a, z) : T_L(a, z);
+        xp = T_P(a, z);
+        tree_replace(a, z, x);
+    } else { // 자식이 둘이면 오른쪽에서 가장 작은 노드 y를 z 자리로 옮김.
+        for (y = T_R(a, z); T_LEFT(y) != 0; y = T_L(a, y))
+            ;
+        removed_red = T_RED(y);
+        x = T_R(a, y);
+        if (T_P(a, y) == z) {
+            xp = y;
+        } else {
+            xp = T_P(a, y);
+            tree_replace(a, y, x);
+            T_RIGHT(y) = T_RIGHT(z);
+            T_PARENT(T_R(a, y)) = PTR_TO_OFF(a, y);
+        }
+        tree_replace(a, z, y);
+        T_LEFT(y) = T_LEFT(z);
+        T_PARENT(T_L(a, y)) = PTR_TO_OFF(a, y);
+        T_RED(y) = T_RED(z);
+    }
+    if (removed_red)
+        return;
 
+    // 검정이 빠졌으면 x 쪽 경로의 검정 수를 하나 채움.
+    while (x != T_ROOT(a) && (x == NULL || !T_RED(x))) {
+        if (x == T_L(a, xp)) {
+            w = T_R(a, xp);
+            if (T_RED(w)) {
+                T_RED(w) = 0;
+                T_RED(xp) = 1;
+                tree_rotate_left(a, xp);
+                w = T_R(a, xp);
+            }
+            if ((T_LEFT(w) == 0 || !T_RED(T_L(a, w))) && (T_RIGHT(w) == 0 || !T_RED(T_R(a, w)))) {
+                T_RED(w) = 1;
+                x = xp;
+                xp = T_P(a, x);
+                continue;
+            }
+            if (T_RIGHT(w) == 0 || !T_RED(T_R(a, w))) {
+                T_RED(T_L(a, w)) = 0;
+                T_RED(w) = 1;
+                tree_rotate_right(a, w);
+                w = T_R(a, xp);
+            }
+            T_RED(w) = T_RED(xp);
+            T_RED(xp) = 0;
+            T_RED(T_R(a, w)) = 0;
+            tree_rotate_left(a, xp);
+        } else {
+            w = T_L(a, xp);
+            if (T_RED(w)) {
+                T_RED(w) = 0;
+                T_RED(xp) = 1;
+                tree_rotate_right(a, xp);
+                w = T_L(a, xp);
+            }
+            if ((T_LEFT(w) == 0 || !T_RED(T_L(a, w))) && (T_RIGHT(w) == 0 || !T_RED(T_R(a, w)))) {
+                T_RED(w) = 1;
+                x = xp;
+                xp = T_P(a, x);
+                continue;
+            }
+            if (T_LEFT(w) == 0 || !T_RED(T_L(a, w))) {
+                T_RED(T_R(a, w)) = 0;
+                T_RED(w) = 1;
+                tree_rotate_left(a, w);
+                w = T_L(a, xp);
+            }
+            T_RED(w) = T_RED(xp);
+            T_RED(xp) = 0;
+            T_RED(T_L(a, w)) = 0;
+            tree_rotate_right(a, xp);
+        }
+        x = T_ROOT(a);
     }
-    PREV_PTR(bp) = NULL; // 초기화
-    NEXT_PTR(bp) = NULL; // 초기화
+    if (x != NULL)
+        T_RED(x) = 0;
+}
+
+// 크기가 alloc_size 이상인 블록 중 가장 작은 것(크기가 같으면 주소가 낮은 것)을 차지해서 트리에서 빼고 돌려줌.
+// 다른 스레드가 차지 중인 블록은 건너뛰고 다음으로 큰 블록을 본다.
+static void *tree_find(arena_t *a, size_t alloc_size)
+{
+    char *n, *best = NULL;
+
+    if (__atomic_load_n(&a->tree_root, __ATOMIC_RELAXED) == 0)
+        return NULL;
+    spin_lock(&a->tree_lock);
+    for (n = T_ROOT(a); n != NULL; ) {
+        if (GET_SIZE(HDRP(n)) >= alloc_size) {
+            best = n;
+            n = T_L(a, n);
+        } else {
+            n = T_R(a, n);
+        }
+    }
+    while (best != NULL && !claim_block(best)) { // 중위 순회의 다음 노드
+        if (T_RIGHT(best) != 0) {
+            for (best = T_R(a, best); T_LEFT(best) != 0; best = T_L(a, best))
+                ;
+        } else {
+            for (n = best, best = T_P(a, n); best != NULL && n == T_R(a, best); n = best, best = T_P(a, n))
+                ;
+        }
+    }
+    if (best != NULL)
+        tree_remove(a, best);
+    spin_unlock(&a->tree_lock);
+    return best;
+}
+
+// 가용 블록의 헤더에 BUSY를 세워 차지함. 할당된 블록이거나 이미 누가 차지했으면 0.
+static int claim_block(void *bp)
+{
+    word_t hdr = GET_ATOMIC(HDRP(bp));
+
+    while (!(hdr & (0x1 | BUSY))) { // CAS가 실패하면 hdr에 현재 값이 들어오니 다시 검사
+        if (__atomic_compare_exchange_n((word_t *)HDRP(bp), &hdr, hdr | BUSY,
+                                        0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return 1;
+    }
+    return 0;
+}
+
+// 헤더를 val로 바꾸되 PREV_ALLOC 비트는 지금 값을 그대로 둔다. 앞블럭 쪽이 동시에 그 비트를 바꿔도 잃지 않음.
+static void put_header(void *hp, word_t val)
+{
+    word_t hdr = GET_ATOMIC(hp);
+
+    while (!__atomic_compare_exchange_n((word_t *)hp, &hdr, (val & ~PREV_ALLOC) | (hdr & PREV_ALLOC),
+                                        0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        ;
+}
+
+static void spin_lock(spin_t *lock)
+{
+    int spins = 0;
+
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED)) {
+            if (++spins > SPIN_LIMIT)
+                sched_yield();
+        }
+    }
+}
+
+static void spin_unlock(spin_t *lock)
+{
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
 }
 
 //사이즈 만큼 확장해주는 함수; 성공시-> 새로 할당된 블록의 시작 주소 반환. 실패하면 NULL 
-static void *extend_heap(size_t words)
+// 돌려주는 블록은 BUSY로 차지된 상태(리스트에 없음)라서, 호출한 쪽이 place 하거나 release_block 해야 한다.
+static void *extend_heap(arena_t *a, size_t words)
 {
     char *bp;
     size_t size;
 
     size = (words % 2) ? (words+1) * WSIZE : words * WSIZE; // 0이 False 짝수, 1이 True 홀수 -> 짝수 워드 단위로 관리하는게 효율적.
-    if ((long)(bp = mem_sbrk(size)) == -1) // mem_sbrk 에서 반환된 값을 정수(큰 정수형 long)로 변환해서 -1인지 확인하기 위함이다.
+    if (size > INTPTR_MAX) // sbrk 증가량(intptr_t)으로 바꾸면 음수가 될 크기는 거절
+        return NULL;
+    spin_lock(&a->top_lock); // 에필로그 자리를 여러 스레드가 동시에 고치지 않도록
+    if ((long)(bp = mem_region_sbrk(a->region, size)) == -1) { // mem_sbrk 에서 반환된 값을 정수(큰 정수형 long)로 변환해서 -1인지 확인하기 위함이다.
+        spin_unlock(&a->top_lock);
         return NULL;
+    }
 
-    PUT(HDRP(bp), PACK(size, 0)); // 블록의 헤더 위치에 size만큼 가용상태를 기록
+    put_header(HDRP(bp), PACK(size, BUSY)); // 원래 에필로그 자리에 새 블록 헤더를 차지된 상태로 기록. 앞블럭 상태는 에필로그에 있던 것 그대로.
     PUT(FTRP(bp), PACK(size, 0));  // 푸터에도 똑같이!
-    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); // 다음 블록의 헤더에 에필로그 블록을 기록함.
+    PUT_ATOMIC(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); // 다음 블록의 헤더에 에필로그 블록을 기록함. 앞블럭(새 블록)은 할당 안 됨.
+    spin_unlock(&a->top_lock);
 
-    return coalesce(bp); 
+    return coalesce(a, bp); 
 }
 
 
@@ -189,130 +823,854 @@ static void *extend_heap(size_t words)
  */
 void *mm_malloc(size_t req_size)
 {
-    size_t alloc_size;
-    size_t extendsize;
+    size_t alloc_size, slot_size;
+    tcache_t *tc;
     char *bp;
 
     if (req_size == 0)
         return NULL; // 사이즈가 0이면 할당할 필요가 없으니 NULL 반환
-    
-    if (req_size <= DSIZE) // 요청한 크기가 너무 작으면 최소 8바이트 할당
-        alloc_size = 2*DSIZE; // 헤더 4, 페이로드 최소 8, 푸터4 = 최소16
+    if (req_size >= mmap_threshold) // 아주 큰 요청은 힙을 늘리지 않고 따로 매핑
+        return huge_alloc(req_size);
 
-    else
-        alloc_size = DSIZE * ((req_size + (DSIZE) + (DSIZE-1)) / DSIZE); // 요청한 크기가 더 크면 8의 배수로 크기 맞춰서 정렬
+    if (req_size <= SLAB_MAX) { // 아주 작은 요청은 슬랩 칸. 스레드 캐시의 칸 bin부터 본다.
+        slot_size = SLOT_SIZE(req_size);
+        tc = tcache_get();
+        if ((bp = tc->slab_bins[SLAB_CLASS(slot_size)]) != NULL) {
+            tc->slab_bins[SLAB_CLASS(slot_size)] = NEXT_PTR(bp);
+            tc->slab_counts[SLAB_CLASS(slot_size)]--;
+            return bp;
+        }
+        if ((bp = tcache_slab_refill(tc, slot_size)) != NULL)
+            return bp;
+        // 슬랩 페이지를 못 만들면 보통 블록으로
+    }
+
+    alloc_size = adjust_size(req_size);
+
+    if (alloc_size <= TCACHE_MAX_SIZE) { // 작은 블록은 먼저 스레드 캐시에서 꺼낸다. 락이 필요 없음.
+        tc = tcache_get();
+        if ((bp = tc->bins[TC_IDX(alloc_size)]) != NULL) {
+            tc->bins[TC_IDX(alloc_size)] = NEXT_PTR(bp);
+            tc->counts[TC_IDX(alloc_size)]--;
+            return bp;
+        }
+        return tcache_refill(tc, alloc_size); // 비어있으면 중앙 리스트에서 한 번에 여러 개 가져옴.
+    }
+    return malloc_block(arena_get(), alloc_size);
+}
+
+// 요청 크기를 헤더를 포함하고 16의 배수로 맞춘 블록 크기로 바꿔줌. 할당된 블록엔 푸터가 없음.
+static size_t adjust_size(size_t req_size)
+{
+    if (req_size <= DSIZE + WSIZE) // 요청한 크기가 너무 작으면 최소 블록 할당
+        return 2*DSIZE; // 가용이 되면 헤더 8, NEXT 4, PREV 4, 푸터 8을 16의 배수로 올려 최소32. 할당 중엔 헤더 뒤 24바이트가 다 페이로드.
+
+    return DSIZE * ((req_size + (WSIZE) + (DSIZE-1)) / DSIZE); // 요청한 크기가 더 크면 16의 배수로 크기 맞춰서 정렬
+}
 
-    if ((bp = find_fit(alloc_size)) != NULL) { // 빈공간 주소 bp에 저장
-        place(bp, alloc_size); // 그 자리에 할당
+// 아레나 a의 가용 리스트에서 블록을 할당함. 필요한 락은 안에서 잡는다.
+static void *malloc_block(arena_t *a, size_t alloc_size)
+{
+    size_t extendsize;
+    char *bp;
+
+    if (__atomic_load_n(&a->remote_frees, __ATOMIC_RELAXED) != NULL) // 다른 스레드가 해제해둔 블록부터 리스트에 돌려놓음.
+        remote_free_drain(a);
+    if (IS_QUICK(alloc_size) && (bp = quick_pop(a, alloc_size)) != NULL) // 같은 크기로 해제해둔 블록은 그대로 다시 씀.
+        return bp;
+    if ((bp = find_fit(a, alloc_size)) != NULL ||
+        (reserve_release(a) && (bp = find_fit(a, alloc_size)) != NULL) ||
+        (quick_flush(a) && (bp = find_fit(a, alloc_size)) != NULL)) { // 빈공간 주소 bp에 저장. 없으면 재할당 예약, 지연 병합 중인 블록을 풀어서 다시 찾아봄.
+        place(a, bp, alloc_size); // 그 자리에 할당
         return bp;
     }
     extendsize = MAX(alloc_size, CHUNKSIZE); //만약 적당한 빈 공간이 없으면, 새로운 메모리 공간을 힙에 추가 함.
-    if ((bp = extend_heap(extendsize/WSIZE)) == NULL) // 최소 요청한 크기 or 정해진 기본크기chunksize 만큼 확장 
+    if ((bp = extend_heap(a, extendsize/WSIZE)) == NULL) // 최소 요청한 크기 or 정해진 기본크기chunksize 만큼 확장 
         return NULL; // 실패하면 NULL 반환
-    place(bp, alloc_size);
+    place(a, bp, alloc_size);
     return bp;
 }
 
 //빈공간을 찾아주는 함수, 요청한 크기만큼 맞는 빈 공간이 있으면 그 공간의 주소를 반환
-static void *find_fit(size_t alloc_size) // malloc에서 이미 요청한 크기에 헤더와 푸터를 포함한 크기를 alloc에 넣음.
+// 찾은 블록은 차지(BUSY)하고 리스트에서 뺀 상태로 돌려준다.
+// lifo, addr은 요청 크기를 다음 2단계 구간 경계로 올려서 찾으므로, 찾은 리스트의 맨 앞 블록이 항상 맞는다.
+// best, exact는 요청 크기가 들어가는 구간부터 크기를 보면서 찾는다.
+// 비어있지 않은 리스트는 비트맵에서 find-first-set으로 바로 고르니 리스트 길이와 상관없이 몇 단계면 끝남.
+// TREE_MIN 이상은 리스트에 없으니 리스트에 맞는 블록이 없으면 트리에서 best fit으로 찾는다.
+static void *find_fit(arena_t *a, size_t alloc_size) // malloc에서 이미 요청한 크기에 헤더를 포함한 크기를 alloc에 넣음.
 {
     void *bp;
-    size_t power = find_next_power(alloc_size);
+    unsigned int idx, fl, sl, sl_map, fl_map;
 
-    while ( power < FREE_LIST_NUMS + 3) {
-        for (bp = FREE_PTR(power); bp != NULL; bp = NEXT_PTR(bp)) { // 
-            if (alloc_size <= GET_SIZE(HDRP(bp))) { // 할당되지 않고, 블록크기가 요청한 크기보다 크거나 같은지.
-                return bp;
-            }
-        }   
-        power += 1;
+    if (alloc_size >= TREE_MIN)
+        return tree_find(a, alloc_size);
+    idx = sc_index(alloc_size);
+    if (policy <= POLICY_ADDR && sc_min_size[idx] < alloc_size && idx < SC_NUM - 1) // 구간 중간 크기면 다음 구간부터 찾아야 다 맞음
+        idx++;
+    fl = FL_MIN + (idx >> SL_LOG2);
+    sl = idx & (SL_COUNT - 1);
+
+    while (fl <= FL_MAX) {
+        sl_map = __atomic_load_n(&a->sl_bitmap[fl - FL_MIN], __ATOMIC_RELAXED) & (~0U << sl); // 이 fl에서 sl 이상인 리스트들
+        if (sl_map == 0) {
+            fl_map = __atomic_load_n(&a->fl_bitmap, __ATOMIC_RELAXED) & (~0U << (fl + 1)); // 더 큰 fl들
+            if (fl_map == 0)
+                break;
+            fl = __builtin_ctz(fl_map);
+            sl = 0;
+            continue;
+        }
+        sl = __builtin_ctz(sl_map);
+
+        spin_lock(LIST_LOCK(a, fl));
+        if ((bp = pick_block(a, LIST_IDX(fl, sl), alloc_size)) != NULL) {
+            unlink_free_block(a, bp, fl, sl);
+            spin_unlock(LIST_LOCK(a, fl));
+            return bp;
+        }
+        spin_unlock(LIST_LOCK(a, fl));
+        if (++sl == SL_COUNT) { // 그 사이 비었거나 쓸 블록이 없으면 다음 리스트부터
+            sl = 0;
+            fl++;
+        }
     } 
+    return tree_find(a, alloc_size);
+}
+
+// 리스트 idx에서 정책대로 블록을 골라 차지해서 돌려줌. 맞는 블록이 없으면 NULL. 그 리스트의 LIST_LOCK을 잡고 불러야 함.
+// best와 (요청 크기 구간의) exact는 맞는 블록을 BEST_FIT_K개까지 보고, 나머지는 맞는 첫 블록. 딱 맞는 블록은 바로 씀.
+static void *pick_block(arena_t *a, unsigned int idx, size_t alloc_size)
+{
+    void *bp, *best = NULL;
+    size_t size, best_size = 0;
+    int seen = 0, limit = 1;
+
+    if (policy == POLICY_BEST || (policy == POLICY_EXACT && sc_min_size[idx] <= alloc_size))
+        limit = BEST_FIT_K;
+    for (bp = FREE_PTR(a, idx); bp != NULL; bp = NEXT_FREE(a, bp)) { // 보통은 첫 블록. 다른 스레드가 차지 중인 블록은 건너뜀.
+        size = GET_SIZE(HDRP(bp));
+        if (size < alloc_size || (GET_ATOMIC(HDRP(bp)) & BUSY)) // 구간 안에서도 크기가 섞여 있으니 크기도 확인
+            continue;
+        if (size == alloc_size) {
+            best = bp;
+            break;
+        }
+        if (best == NULL || (policy == POLICY_BEST && size < best_size)) {
+            best = bp;
+            best_size = size;
+        }
+        if (++seen == limit)
+            break;
+    }
+    if (best == NULL)
+        return NULL;
+    if (claim_block(best))
+        return best;
+    for (bp = FREE_PTR(a, idx); bp != NULL; bp = NEXT_FREE(a, bp)) { // 고른 블록을 그 사이 다른 스레드가 차지했으면 맞는 첫 블록으로
+        if (alloc_size <= GET_SIZE(HDRP(bp)) && claim_block(bp))
+            return bp;
+    }
     return NULL;
 }
 
 //요청된 블록을 할당하는 함수. 블록 할당하고 남은 공간이 충분히 크면 분할하는 로직도 포함함.
-static void place(void *bp, size_t alloc_size)  // alloc 사이즈가 헤더 푸터 포함한거임.
+// bp는 이미 차지해서 리스트에서 빠진 블록이어야 함.
+static void place(arena_t *a, void *bp, size_t alloc_size)  // alloc 사이즈가 헤더 포함한거임.
 {
     size_t block_size = GET_SIZE(HDRP(bp)); 
-    size_t remain_size = block_size - alloc_size;
+    spin_t *lock;
 
-    if ((remain_size) >= (2*DSIZE)) { // 블럭에서 할당된 크기를 뺐는데도 최소 한 블럭 만들수 있는 크기 나오면 분할
-        PUT(HDRP(bp), PACK(alloc_size, 1)); // 헤더에 할당된 사이즈 할당
-        PUT(FTRP(bp), PACK(alloc_size, 1)); // 푸터에도 똑같이 저장
-        remove_free_block(bp, block_size);
-        bp = NEXT_BLKP(bp); // 다음 블럭 포인트, 할당된 사이즈 계산해서 옮기는거임.
-        PUT(HDRP(bp), PACK(remain_size, 0)); // 남은 크기 정보에 넣어주고 가용상태로 만들기.
-        PUT(FTRP(bp), PACK(remain_size, 0)); // 푸터에도 똑같이.
-        add_free_block(bp, remain_size);
+    if ((block_size - alloc_size) >= (2*DSIZE)) { // 블럭에서 할당된 크기를 뺐는데도 최소 한 블럭 만들수 있는 크기 나오면 분할
+        shrink_block(a, bp, alloc_size);
 
     } else { // 하나 만들 사이즈 안나오면 그냥 할당만 해주기.
-        PUT(HDRP(bp), PACK(block_size, 1)); 
-        PUT(FTRP(bp), PACK(block_size, 1));
-        remove_free_block(bp, block_size);
+        put_header(HDRP(bp), PACK(block_size, 1)); 
+        lock = TAG_LOCK(HDRP(NEXT_BLKP(bp)));
+        spin_lock(lock);
+        __atomic_fetch_or((word_t *)HDRP(NEXT_BLKP(bp)), PREV_ALLOC, __ATOMIC_RELEASE); // 뒷블럭에게 앞블럭이 할당됐다고 알려줌.
+        spin_unlock(lock);
     }
 }
 
+// 차지했거나 할당된 블록 bp를 alloc_size로 할당하고, 남는 뒷부분이 한 블록이 되면 떼어서 가용으로 돌려줌.
+// 뒷블럭의 PREV_ALLOC은 떼어낸 블록이 병합될 때 정리되므로 bp 뒤는 원래 할당된 것처럼 보여야 한다.
+static void shrink_block(arena_t *a, void *bp, size_t alloc_size)
+{
+    size_t remain_size;
+    spin_t *lock;
+
+    if (GET_SIZE(HDRP(bp)) < alloc_size + (2*DSIZE)) // 떼어낼 만큼 안 남으면(alloc_size가 블록보다 커도) 그대로 둠.
+        return;
+    remain_size = GET_SIZE(HDRP(bp)) - alloc_size;
+    put_header(HDRP(bp), PACK(alloc_size, 1)); // 헤더에 할당된 사이즈 할당. 푸터는 없음.
+    bp = NEXT_BLKP(bp); // 다음 블럭 포인트, 할당된 사이즈 계산해서 옮기는거임.
+    PUT_ATOMIC(HDRP(bp), PACK(remain_size, PREV_ALLOC | BUSY)); // 남은 블록은 차지된 채로 만들고. 블록 안쪽이라 아직 다른 스레드는 못 봄.
+    lock = TAG_LOCK(HDRP(NEXT_BLKP(bp)));
+    spin_lock(lock);
+    PUT(FTRP(bp), PACK(remain_size, 0)); // 푸터는 뒷블럭이 읽을 수 있으니 경계 락을 잡고 씀.
+    spin_unlock(lock);
+    release_block(a, bp); // 가용 리스트에 넣고 풀어줌.
+}
+
+// 할당된 블록 bp 바로 뒤의 차지된 블록 next(리스트에서 빠진 상태)를 흡수해서 bp를 키우고 새 크기를 돌려줌.
+static size_t absorb_next(void *bp, void *next)
+{
+    size_t size = GET_SIZE(HDRP(bp)) + GET_SIZE(HDRP(next));
+    spin_t *lock;
+
+    put_header(HDRP(bp), PACK(size, 1));
+    lock = TAG_LOCK(HDRP(NEXT_BLKP(bp)));
+    spin_lock(lock);
+    __atomic_fetch_or((word_t *)HDRP(NEXT_BLKP(bp)), PREV_ALLOC, __ATOMIC_RELEASE); // 흡수한 블록 뒤에게 앞블럭이 할당됐다고 알려줌.
+    spin_unlock(lock);
+    return size;
+}
+
+// 내 아레나의 할당된 블록 bp를 제자리에서 alloc_size로 바꿔봄. 되면 1, 복사해야 하면 0.
+// 줄일 때는 뒷부분을 떼어주고, 늘릴 때는 뒷블럭이 가용이거나 예약이면 흡수하고, 그래도 모자란데 힙 끝이면 힙을 늘려서 흡수함.
+// 늘렸으면 남는 부분은 다음 재할당을 위한 예약으로 남긴다.
+static int realloc_in_place(arena_t *a, void *bp, size_t alloc_size)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    size_t reserve = alloc_size - size; // 처음 예약은 이번에 커진 만큼
+    char *next, *ext;
+    int taken = 0; // 뒷블럭을 차지했는지
+
+    if (alloc_size <= size) { // 줄이거나 그대로
+        shrink_block(a, bp, alloc_size);
+        return 1;
+    }
+
+    next = (char *)bp + size;
+    if (reserve_take(a, next)) { // 지난번에 남겨둔 예약이면 이미 차지된 상태. 다 쓰고 또 커지니 다음 예약은 두 배로.
+        reserve = MAX(reserve, 2 * GET_SIZE(HDRP(next)));
+        taken = 1;
+    } else if (claim_block(next)) { // 뒷블럭이 가용이면 차지
+        remove_free_block(a, next, GET_SIZE(HDRP(next)));
+        taken = 1;
+    }
+    reserve = MIN(reserve, MIN(alloc_size, RESERVE_MAX)); // 예약은 블록 크기와 RESERVE_MAX를 넘지 않음
+
+    if (taken) {
+        if (size + GET_SIZE(HDRP(next)) < alloc_size && GET_SIZE(HDRP(NEXT_BLKP(next))) != 0) {
+            release_block(a, next); // 합쳐도 모자라고 힙 끝도 아니면 돌려놓고 복사
+            return 0;
+        }
+        size = absorb_next(bp, next);
+        next = (char *)bp + size;
+    }
+
+    if (size < alloc_size) {
+        if (GET_SIZE(HDRP(next)) != 0) // 에필로그가 아니면 더는 못 늘림
+            return 0;
+        if ((ext = extend_heap(a, (alloc_size + reserve - size) / WSIZE)) == NULL &&
+            (ext = extend_heap(a, MAX(alloc_size - size, 2*DSIZE) / WSIZE)) == NULL) // 예약까지는 못 늘리면 필요한 만큼만
+            return 0;
+        if (ext != next) { // 같은 아레나를 쓰는 다른 스레드가 먼저 힙을 늘렸으면 새 블록은 돌려놓고 복사
+            release_block(a, ext);
+            return 0;
+        }
+        absorb_next(bp, ext);
+    }
+    reserve_split(a, bp, alloc_size, reserve); // 남는 부분은 예약으로, 예약보다 많이 남으면 나머지는 가용으로
+    return 1;
+}
+
+// 할당된 블록 bp를 alloc_size로 줄이고, 그 뒤 최대 reserve 바이트를 예약으로 남긴다. 그보다 더 남는 부분은 가용으로 돌려줌.
+static void reserve_split(arena_t *a, void *bp, size_t alloc_size, size_t reserve)
+{
+    size_t remain_size;
+    spin_t *lock;
+    char *rp;
+
+    shrink_block(a, bp, alloc_size + reserve);
+    remain_size = GET_SIZE(HDRP(bp)) - alloc_size;
+    if (remain_size < (2*DSIZE)) // 예약을 만들 만큼 안 남으면 그대로 둠.
+        return;
+    put_header(HDRP(bp), PACK(alloc_size, 1));
+    rp = NEXT_BLKP(bp);
+    PUT_ATOMIC(HDRP(rp), PACK(remain_size, PREV_ALLOC | BUSY)); // 예약은 계속 차지된 상태라 아무도 가져가거나 병합하지 못함.
+    lock = TAG_LOCK(HDRP(NEXT_BLKP(rp)));
+    spin_lock(lock);
+    PUT(FTRP(rp), PACK(remain_size, 0));
+    __atomic_fetch_and((word_t *)HDRP(NEXT_BLKP(rp)), ~PREV_ALLOC, __ATOMIC_RELEASE); // 뒷블럭에게는 앞블럭이 가용으로 보임.
+    spin_unlock(lock);
+    reserve_put(a, rp);
+}
+
+// bp가 아레나 a의 예약 블록이면 목록에서 빼고 1. bp는 차지된 상태 그대로 호출한 쪽이 가진다.
+static int reserve_take(arena_t *a, void *bp)
+{
+    int i, found = 0;
+
+    if ((GET_ATOMIC(HDRP(bp)) & (0x1 | BUSY)) != BUSY) // 예약은 항상 할당 0, BUSY 1
+        return 0;
+    spin_lock(&a->reserve_lock);
+    for (i = 0; i < RESERVE_SLOTS; i++) {
+        if (a->reserves[i] == bp) {
+            a->reserves[i] = NULL;
+            found = 1;
+            break;
+        }
+    }
+    spin_unlock(&a->reserve_lock);
+    return found;
+}
+
+// 차지된 블록 bp를 예약 목록에 넣음. 자리가 없으면 가장 오래된 예약을 가용 리스트로 돌려준다.
+static void reserve_put(arena_t *a, void *bp)
+{
+    void *old = NULL;
+    int i;
+
+    spin_lock(&a->reserve_lock);
+    for (i = 0; i < RESERVE_SLOTS && a->reserves[i] != NULL; i++)
+        ;
+    if (i == RESERVE_SLOTS) {
+        i = a->reserve_next;
+        a->reserve_next = (i + 1) % RESERVE_SLOTS;
+        old = a->reserves[i];
+    }
+    a->reserves[i] = bp;
+    spin_unlock(&a->reserve_lock);
+    if (old != NULL)
+        release_block(a, old);
+}
+
+// 아레나 a의 예약을 모두 가용 리스트로 돌려주고, 돌려준 수를 반환.
+static int reserve_release(arena_t *a)
+{
+    void *bps[RESERVE_SLOTS];
+    int i, n = 0;
+
+    spin_lock(&a->reserve_lock);
+    for (i = 0; i < RESERVE_SLOTS; i++) {
+        if (a->reserves[i] != NULL) {
+            bps[n++] = a->reserves[i];
+            a->reserves[i] = NULL;
+        }
+    }
+    spin_unlock(&a->reserve_lock);
+    for (i = 0; i < n; i++) // 병합하면서 다른 락을 잡으므로 예약 락은 놓고 돌려줌
+        release_block(a, bps[i]);
+    return n;
+}
+
 // 동적 메모리 할당에서 블록을 해제하는 함수
 void mm_free(void *bp)
 {
-    size_t size = GET_SIZE(HDRP(bp)); //블록 크기 가져오기.
+    size_t size;
+    tcache_t *tc;
+    slab_t *slab;
+    int cls;
+
+    if (bp == NULL)
+        return;
+
+    if ((slab = slab_of(bp)) == NULL && IS_HUGE(bp)) { // 따로 매핑한 블록은 바로 OS에 돌려줌
+        huge_free(bp);
+        return;
+    }
+    if (slab != NULL) { // 슬랩 칸은 칸 크기별 bin으로
+        cls = SLAB_CLASS(slab->slot_size);
+        tc = tcache_get();
+        if (tc->slab_counts[cls] >= TCACHE_FILL)
+            tcache_drain(&tc->slab_bins[cls], &tc->slab_counts[cls], TCACHE_BATCH);
+        NEXT_PTR(bp) = tc->slab_bins[cls];
+        tc->slab_bins[cls] = bp;
+        tc->slab_counts[cls]++;
+        return;
+    }
+
+    size = GET_SIZE(HDRP(bp)); //블록 크기 가져오기.
+    if (size <= TCACHE_MAX_SIZE) { // 작은 블록은 할당 상태 그대로 스레드 캐시에 넣어둔다. 병합은 중앙으로 돌아갈 때 함.
+        tc = tcache_get();
+        if (tc->counts[TC_IDX(size)] >= TCACHE_FILL) // 꽉 찼으면 일부를 중앙 리스트로 돌려보냄.
+            tcache_drain(&tc->bins[TC_IDX(size)], &tc->counts[TC_IDX(size)], TCACHE_BATCH);
+        NEXT_PTR(bp) = tc->bins[TC_IDX(size)];
+        tc->bins[TC_IDX(size)] = bp;
+        tc->counts[TC_IDX(size)]++;
+        return;
+    }
+    free_block(bp);
+}
+
+// 할당된 블록을 주인 아레나의 가용 리스트로 돌려보냄.
+// 내 아레나의 블록이 아니면 락을 잡지 않고 주인의 remote_frees에 넣어둔다.
+static void free_block(void *bp)
+{
+    arena_t *a = arena_of(bp);
+
+    if (a != my_arena || my_arena_gen != heap_gen) {
+        remote_free_push(a, bp);
+        return;
+    }
+    free_local(a, bp);
+}
+
+// 내 아레나 a의 블록이나 슬랩 칸을 돌려놓음.
+static void free_local(arena_t *a, void *bp)
+{
+    slab_t *slab;
+    size_t size;
+
+    if ((slab = slab_of(bp)) != NULL) {
+        slab_free(a, slab, bp);
+        return;
+    }
+    size = GET_SIZE(HDRP(bp));
+    if (IS_QUICK(size)) { // 지연 병합 : 병합은 나중에 한꺼번에
+        quick_push(a, bp, size);
+        return;
+    }
+    put_header(HDRP(bp), PACK(size, BUSY)); // 할당 해제하되, 리스트에 들어가기 전까지는 차지된 상태로 둔다.
+    release_block(a, bp);
+}
+
+// 할당 상태 그대로인 블록 bp(크기 size)를 quick 리스트에 넣음. QUICK_LIMIT이 넘게 쌓이면 모두 병합해서 돌려줌.
+static void quick_push(arena_t *a, void *bp, size_t size)
+{
+    size_t bytes;
+
+    spin_lock(&a->quick_lock);
+    NEXT_PTR(bp) = a->quick[QUICK_IDX(size)];
+    a->quick[QUICK_IDX(size)] = bp;
+    bytes = a->quick_bytes += size;
+    spin_unlock(&a->quick_lock);
+    if (bytes > QUICK_LIMIT)
+        quick_flush(a);
+}
+
+// quick 리스트에서 크기가 딱 size인 블록을 꺼냄. 없으면 NULL.
+static void *quick_pop(arena_t *a, size_t size)
+{
+    void *bp;
+
+    if (__atomic_load_n(&a->quick[QUICK_IDX(size)], __ATOMIC_RELAXED) == NULL) // 비어있으면 락 없이 바로
+        return NULL;
+    spin_lock(&a->quick_lock);
+    if ((bp = a->quick[QUICK_IDX(size)]) != NULL) {
+        a->quick[QUICK_IDX(size)] = NEXT_PTR(bp);
+        a->quick_bytes -= size;
+    }
+    spin_unlock(&a->quick_lock);
+    return bp;
+}
+
+// quick 리스트를 통째로 떼어와서 블록마다 병합하고 가용 리스트에 넣음. 돌려준 블록이 없으면 0.
+static int quick_flush(arena_t *a)
+{
+    void *lists[QUICK_BINS], *bp, *next;
+    int i;
+
+    if (__atomic_load_n(&a->quick_bytes, __ATOMIC_RELAXED) == 0)
+        return 0;
+    spin_lock(&a->quick_lock);
+    memcpy(lists, a->quick, sizeof(lists));
+    memset(a->quick, 0, sizeof(lists));
+    a->quick_bytes = 0;
+    spin_unlock(&a->quick_lock);
+    for (i = 0; i < QUICK_BINS; i++) {
+        for (bp = lists[i]; bp != NULL; bp = next) {
+            next = NEXT_PTR(bp);
+            put_header(HDRP(bp), PACK(GET_SIZE(HDRP(bp)), BUSY));
+            release_block(a, bp);
+        }
+    }
+    return 1;
+}
+
+// 다른 스레드가 해제한 블록을 아레나 a의 remote_frees 스택에 넣음. 여러 스레드가 동시에 넣어도 됨(CAS).
+static void remote_free_push(arena_t *a, void *bp)
+{
+    void *head = __atomic_load_n(&a->remote_frees, __ATOMIC_RELAXED);
+
+    do {
+        NEXT_PTR(bp) = head;
+    } while (!__atomic_compare_exchange_n(&a->remote_frees, &head, bp, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    __atomic_fetch_add(&a->remote_pushed, 1, __ATOMIC_RELAXED);
+}
+
+// remote_frees 스택을 통째로 떼어와서 블록들을 병합하고 가용 리스트에 넣음.
+// 통째로 가져가므로 pop끼리 경쟁하지 않아 ABA 문제가 없다.
+static void remote_free_drain(arena_t *a)
+{
+    void *bp, *next;
+    size_t n = 0;
+
+    bp = __atomic_exchange_n(&a->remote_frees, NULL, __ATOMIC_ACQUIRE);
+    while (bp != NULL) {
+        next = NEXT_PTR(bp);
+        free_local(a, bp);
+        bp = next;
+        n++;
+    }
+    __atomic_fetch_add(&a->remote_drained, n, __ATOMIC_RELAXED);
+}
+
+// 지금 스레드의 캐시를 비우고(다른 아레나 블록은 주인의 remote_frees로 감), 내 아레나에 쌓인 remote_frees를 돌려놓음.
+// 모든 스레드가 한 번씩 부른 뒤 다시 한 번씩 부르면 다른 스레드가 해제한 블록이 모두 주인 리스트로 돌아간다. mstress -x가 씀.
+void mm_thread_flush(void)
+{
+    tcache_flush(tcache_get());
+    if (my_arena != NULL && my_arena_gen == heap_gen &&
+        __atomic_load_n(&my_arena->remote_frees, __ATOMIC_RELAXED) != NULL)
+        remote_free_drain(my_arena);
+}
+
+// 모든 아레나의 remote_frees에 들어온 블록 수와 주인이 돌려놓은 블록 수.
+void mm_remote_stats(size_t *pushed, size_t *drained)
+{
+    int i;
+
+    *pushed = *drained = 0;
+    for (i = 0; i < MAX_ARENAS; i++) {
+        *pushed += __atomic_load_n(&arenas[i].remote_pushed, __ATOMIC_RELAXED);
+        *drained += __atomic_load_n(&arenas[i].remote_drained, __ATOMIC_RELAXED);
+    }
+}
+
+// 차지된 블록을 이웃과 병합한 뒤 아레나 a의 가용 리스트에 넣고 BUSY를 풀어줌.
+// 힙 끝 블록이 크면 brk를 줄이고, 해제된 부분이 페이지 여러 개에 걸치면 그 페이지들을 OS에 돌려준다.
+static void release_block(arena_t *a, void *bp)
+{
+    char *lo = bp, *hi = (char *)bp + GET_SIZE(HDRP(bp)); // 이번에 해제된 부분
+    unsigned long page = mem_pagesize();
+    size_t size;
+
+    bp = coalesce(a, bp);
+    size = GET_SIZE(HDRP(bp));
+    if (size > TRIM_THRESHOLD && GET_SIZE(HDRP(NEXT_BLKP(bp))) == 0)
+        size = trim_top(a, bp, size);
+    // 병합된 블록 안에서 이번에 해제된 부분이 걸친 페이지까지. 리스트 링크와 푸터 자리는 빼고 돌려줌.
+    lo = MAX((char *)bp + DSIZE, (char *)((unsigned long)lo & ~(page - 1)));
+    hi = MIN((char *)FTRP(bp), (char *)(((unsigned long)hi + page - 1) & ~(page - 1)));
+    if (hi - lo >= DECOMMIT_MIN)
+        mem_decommit(lo, hi - lo);
+    add_free_block(a, bp, size); // 리스트에 먼저 넣고
+    put_header(HDRP(bp), PACK(size, 0)); // 그 다음 풀어야 다른 스레드가 리스트에 없는 가용 블록을 보지 않음.
+}
+
+// 차지된 가용 블록 bp(크기 size)가 힙 끝 블록이면 TRIM_KEEP만 남기고 brk를 줄임. 줄인 뒤의 크기를 돌려줌.
+static size_t trim_top(arena_t *a, void *bp, size_t size)
+{
+    size_t trim = size - TRIM_KEEP;
+
+    spin_lock(&a->top_lock); // 다른 스레드가 그 사이 힙을 늘리지 못하게
+    if (GET_SIZE(HDRP(NEXT_BLKP(bp))) != 0 || mem_region_sbrk(a->region, -(intptr_t)trim) == (void *)-1) {
+        spin_unlock(&a->top_lock); // 힙 끝이 아니면 그대로
+        return size;
+    }
+    size = TRIM_KEEP;
+    put_header(HDRP(bp), PACK(size, BUSY));
+    PUT(FTRP(bp), PACK(size, 0)); // 뒤는 에필로그뿐이고, 힙을 늘리는 쪽은 top_lock을 기다리므로 경계 락은 필요 없음.
+    PUT_ATOMIC(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); // 새 에필로그. 앞블럭(bp)은 할당 안 됨.
+    spin_unlock(&a->top_lock);
+    return size;
+}
+
+// 지금 스레드의 캐시를 돌려줌. mm_init 이후 처음 쓰는 거면 이전 힙의 블록을 버리고 새로 시작한다.
+static tcache_t *tcache_get(void)
+{
+    tcache_t *tc = &tcache;
 
-    PUT(HDRP(bp), PACK(size, 0)); // 헤더에 블록크기와 가용상태를 기록함.
-    PUT(FTRP(bp), PACK(size, 0)); // 푸터에도
-    coalesce(bp); // 위에 설명함.
+    if (tc->gen != heap_gen) {
+        memset(tc->bins, 0, sizeof(tc->bins));
+        memset(tc->counts, 0, sizeof(tc->counts));
+        memset(tc->slab_bins, 0, sizeof(tc->slab_bins));
+        memset(tc->slab_counts, 0, sizeof(tc->slab_counts));
+        tc->gen = heap_gen;
+        pthread_setspecific(tcache_key, tc); // 스레드가 끝날 때 tcache_flush가 불리도록 등록
+    }
+    return tc;
+}
+
+// 캐시가 비었을 때 중앙 리스트에서 최대 TCACHE_BATCH개를 가져온다.
+// 첫 블록은 바로 돌려주고, 나머지는 이미 있는 가용 블록에서 떼어낼 수 있을 때만 캐시에 채운다.
+static void *tcache_refill(tcache_t *tc, size_t alloc_size)
+{
+    arena_t *a = arena_get();
+    void *bp, *extra;
+    size_t size;
+    int i;
+
+    bp = malloc_block(a, alloc_size);
+    for (i = 1; bp != NULL && i < TCACHE_BATCH; i++) {
+        if ((extra = find_fit(a, alloc_size)) == NULL) // 힙을 늘려가면서까지 채우지는 않음.
+            break;
+        place(a, extra, alloc_size);
+        size = GET_SIZE(HDRP(extra)); // 분할이 안 되면 요청보다 조금 클 수 있으니 실제 크기의 bin에 넣음.
+        if (size > TCACHE_MAX_SIZE || tc->counts[TC_IDX(size)] >= TCACHE_FILL) {
+            free_block(extra);
+            break;
+        }
+        NEXT_PTR(extra) = tc->bins[TC_IDX(size)];
+        tc->bins[TC_IDX(size)] = extra;
+        tc->counts[TC_IDX(size)]++;
+    }
+    return bp;
+}
+
+// 칸 bin이 비었을 때 슬랩 페이지 하나에서 최대 TCACHE_BATCH개를 가져온다. 첫 칸은 바로 돌려줌.
+static void *tcache_slab_refill(tcache_t *tc, size_t slot_size)
+{
+    arena_t *a = arena_get();
+    int cls = SLAB_CLASS(slot_size);
+    void *bp, *extra;
+    int i;
+
+    if (__atomic_load_n(&a->remote_frees, __ATOMIC_RELAXED) != NULL) // 다른 스레드가 해제해둔 칸부터 돌려놓음.
+        remote_free_drain(a);
+    bp = slab_alloc(a, slot_size);
+    for (i = 1; bp != NULL && i < TCACHE_BATCH; i++) {
+        if ((extra = slab_alloc(a, slot_size)) == NULL)
+            break;
+        NEXT_PTR(extra) = tc->slab_bins[cls];
+        tc->slab_bins[cls] = extra;
+        tc->slab_counts[cls]++;
+    }
+    return bp;
+}
+
+// bin에서 n개의 블록(또는 칸)을 꺼내 중앙 리스트로 돌려보냄.
+static void tcache_drain(void **bin, unsigned char *count, int n)
+{
+    void *bp;
+
+    while (n-- > 0 && (bp = *bin) != NULL) {
+        *bin = NEXT_PTR(bp);
+        (*count)--;
+        free_block(bp);
+    }
+}
+
+// 스레드가 끝날 때 캐시에 남은 블록을 모두 중앙 리스트로 돌려보냄.
+static void tcache_flush(void *arg)
+{
+    tcache_t *tc = arg;
+    int i;
+
+    if (tc->gen != heap_gen) // 그 사이 mm_init으로 힙이 바뀌었으면 돌려보낼 것이 없음.
+        return;
+    for (i = 0; i < TCACHE_BINS; i++)
+        tcache_drain(&tc->bins[i], &tc->counts[i], TCACHE_FILL);
+    for (i = 0; i < SLAB_CLASSES; i++)
+        tcache_drain(&tc->slab_bins[i], &tc->slab_counts[i], TCACHE_FILL);
+}
+
+static void tcache_init(void)
+{
+    pthread_key_create(&tcache_key, tcache_flush);
+}
+
+// bp가 슬랩 칸이면 그 페이지 머리를, 아니면 NULL.
+static slab_t *slab_of(void *bp)
+{
+    int region = mem_region_of(bp);
+    arena_t *a;
+    unsigned long page;
+
+    if (region < 0)
+        return NULL;
+    a = &arenas[region];
+    page = ((unsigned long)bp >> SLAB_PAGE_SHIFT) - ((unsigned long)a->base >> SLAB_PAGE_SHIFT);
+    if (page >= SLAB_PAGES_MAX || !(__atomic_load_n(&a->slab_map[page / 32], __ATOMIC_ACQUIRE) & (1U << (page % 32))))
+        return NULL;
+    return (slab_t *)((unsigned long)bp & ~(unsigned long)(SLAB_PAGE - 1));
+}
+
+// 아레나 a에서 slot_size 칸 하나를 꺼냄. 빈칸 있는 페이지가 없으면 새 페이지를 만든다.
+static void *slab_alloc(arena_t *a, size_t slot_size)
+{
+    slab_class_t *sc = &a->slab_classes[SLAB_CLASS(slot_size)];
+    slab_t *slab;
+    unsigned int i, w;
+
+    spin_lock(&sc->lock);
+    while ((slab = sc->partial) == NULL) {
+        spin_unlock(&sc->lock); // 페이지를 만드는 동안 다른 스레드가 이 크기를 쓸 수 있게 락을 놓음.
+        if ((slab = slab_page_new(a)) == NULL)
+            return NULL;
+        slab->slot_size = slot_size;
+        slab->nslots = (SLAB_PAGE - SLAB_OFFSET) / slot_size;
+        slab->nfree = slab->nslots;
+        memset(slab->free_map, 0, sizeof(slab->free_map));
+        for (i = 0; i < slab->nslots; i++)
+            slab->free_map[i / 32] |= 1U << (i % 32);
+        spin_lock(&sc->lock);
+        slab->prev = NULL;
+        slab->next = sc->partial;
+        if (sc->partial != NULL)
+            sc->partial->prev = slab;
+        sc->partial = slab;
+    }
+
+    for (w = 0; slab->free_map[w] == 0; w++) // partial에 있으니 빈칸이 반드시 있음.
+        ;
+    i = w * 32 + __builtin_ctz(slab->free_map[w]);
+    slab->free_map[w] &= ~(1U << (i % 32));
+    if (--slab->nfree == 0) { // 꽉 찼으면 partial에서 뺌
+        sc->partial = slab->next;
+        if (slab->next != NULL)
+            slab->next->prev = NULL;
+    }
+    spin_unlock(&sc->lock);
+    return (char *)slab + SLAB_OFFSET + i * slab->slot_size;
+}
+
+// 슬랩 칸 bp를 비트맵에 돌려놓음. 페이지가 다 비면 slab_empty로 옮겨 다른 크기로도 쓰게 한다.
+static void slab_free(arena_t *a, slab_t *slab, void *bp)
+{
+    slab_class_t *sc = &a->slab_classes[SLAB_CLASS(slab->slot_size)];
+    unsigned int i = ((char *)bp - ((char *)slab + SLAB_OFFSET)) / slab->slot_size;
+
+    spin_lock(&sc->lock);
+    slab->free_map[i / 32] |= 1U << (i % 32);
+    if (++slab->nfree == 1) { // 꽉 차서 빠져 있던 페이지면 다시 partial로
+        slab->prev = NULL;
+        slab->next = sc->partial;
+        if (sc->partial != NULL)
+            sc->partial->prev = slab;
+        sc->partial = slab;
+    }
+    if (slab->nfree < slab->nslots || (sc->partial == slab && slab->next == NULL)) { // 이 크기의 마지막 페이지는 남겨둠
+        spin_unlock(&sc->lock);
+        return;
+    }
+    if (slab->prev != NULL) // 다 빈 페이지는 partial에서 빼고
+        slab->prev->next = slab->next;
+    else
+        sc->partial = slab->next;
+    if (slab->next != NULL)
+        slab->next->prev = slab->prev;
+    spin_unlock(&sc->lock);
+
+    spin_lock(&a->slab_empty_lock);
+    slab->next = a->slab_empty;
+    a->slab_empty = slab;
+    spin_unlock(&a->slab_empty_lock);
 }
 
-// 새로 만든 블록이 인접 가용 블록들과 병합 가능한지 확인하고 가능하면 합치고 그 시작 주소를 반환함.
-static void *coalesce(void *bp) // 코얼레스 = 합체하다.
+// 슬랩으로 쓸 페이지 하나를 구함. 다 빈 페이지가 있으면 그걸 쓰고, 없으면 힙 끝에 페이지 경계에 맞춘 블록을 만든다.
+static slab_t *slab_page_new(arena_t *a)
+{
+    slab_t *slab;
+    char *brk, *bp;
+    size_t pad;
+    unsigned long page;
+
+    spin_lock(&a->slab_empty_lock);
+    if ((slab = a->slab_empty) != NULL)
+        a->slab_empty = slab->next;
+    spin_unlock(&a->slab_empty_lock);
+    if (slab != NULL)
+        return slab;
+
+    spin_lock(&a->top_lock);
+    brk = mem_region_sbrk(a->region, 0); // 지금 힙 끝. 그 바로 앞 워드가 에필로그.
+    pad = (SLAB_PAGE - ((unsigned long)brk & (SLAB_PAGE - 1))) & (SLAB_PAGE - 1); // 페이지 경계까지 남은 칸
+    if (pad != 0 && pad < 2*DSIZE) // 최소 블록보다 작으면 다음 경계로
+        pad += SLAB_PAGE;
+    page = ((unsigned long)(brk + pad) >> SLAB_PAGE_SHIFT) - ((unsigned long)a->base >> SLAB_PAGE_SHIFT);
+    if (page >= SLAB_PAGES_MAX || mem_region_sbrk(a->region, pad + SLAB_PAGE + DSIZE) == (void *)-1) {
+        spin_unlock(&a->top_lock);
+        return NULL;
+    }
+    bp = brk + pad; // 페이지 경계
+    if (pad != 0) { // 경계 앞 남는 공간은 가용 블록으로
+        put_header(HDRP(brk), PACK(pad, BUSY));
+        PUT(FTRP(brk), PACK(pad, 0));
+        PUT_ATOMIC(HDRP(bp), PACK(SLAB_PAGE + DSIZE, 1)); // 페이지 전체가 페이로드인 할당 블록. 앞블럭(남는 공간)은 할당 안 됨.
+    } else {
+        put_header(HDRP(bp), PACK(SLAB_PAGE + DSIZE, 1));
+    }
+    PUT_ATOMIC(HDRP(NEXT_BLKP(bp)), PACK(0, PREV_ALLOC | 1)); // 새 에필로그
+    __atomic_fetch_or(&a->slab_map[page / 32], 1U << (page % 32), __ATOMIC_RELEASE);
+    spin_unlock(&a->top_lock);
+
+    if (pad != 0)
+        release_block(a, brk);
+    return (slab_t *)bp;
+}
+
+// 차지된 블록 bp를 인접 가용 블록들과 병합하고, 병합된 블록(역시 차지된 상태, 리스트에 없음)을 돌려줌.
+static void *coalesce(arena_t *a, void *bp) // 코얼레스 = 합체하다.
 {
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp))); // 앞블럭의 가용상태
-    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp))); // 뒷블럭의 가용상태
     size_t size = GET_SIZE(HDRP(bp)); // 현재 블럭의 크기
+    word_t prev_footer;
+    char *prev_bp = NULL;
+    spin_t *lock;
 
-    if (prev_alloc && next_alloc ) { // 둘다 할당 된 상태
-        add_free_block(bp, size);
+    // 뒷블럭 : 내 크기는 나만 바꾸니 뒷블럭 헤더 위치는 확실함. 차지에 성공하면 가져온다.
+    while (claim_block((char *)bp + size)) {
+        remove_free_block(a, (char *)bp + size, GET_SIZE(HDRP((char *)bp + size)));
+        size += GET_SIZE(HDRP((char *)bp + size)); // 사이즈를 뒷블럭 크기만큼 키움. 흡수된 헤더는 BUSY로 남아 아무도 차지 못함.
+    }
 
-        return bp;
+    // 앞블럭 : PREV_ALLOC과 앞블럭 푸터는 앞블럭 주인이 바꿀 수 있으니 경계 락을 잡은 채로 읽고 차지한다.
+    // 앞블럭이 할당된 상태면 푸터가 없으니(페이로드임) 읽지 않는다.
+    lock = TAG_LOCK(HDRP(bp));
+    spin_lock(lock);
+    if (!GET_PREV_ALLOC(HDRP(bp))) {
+        prev_footer = GET(HDRP(bp) - WSIZE);
+        if (claim_block((char *)bp - (prev_footer & ~0x7)))
+            prev_bp = (char *)bp - (prev_footer & ~0x7);
+    }
+    spin_unlock(lock);
+
+    if (prev_bp != NULL) { // 앞블럭을 차지했으면 리스트에서 빼고 합침.
+        remove_free_block(a, prev_bp, GET_SIZE(HDRP(prev_bp)));
+        size += GET_SIZE(HDRP(prev_bp)); 
+        bp = prev_bp; // 헤더는 앞블럭의 헤더위치로 옮겨 줘야 함.
+    }
 
-    } else if (prev_alloc && !next_alloc){ // 뒷블럭만 가용상태
-        size += GET_SIZE(HDRP(NEXT_BLKP(bp))); // 사이즈를 뒷블럭 크기만큼 키움.
-        remove_free_block(NEXT_BLKP(bp), GET_SIZE(HDRP(NEXT_BLKP(bp))));
-        PUT(HDRP(bp), PACK(size, 0)); // 헤더 푸터 정보 갱신
-        PUT(FTRP(bp), PACK(size, 0));
-
-    } else if (!prev_alloc && next_alloc){ // 앞블럭만 가용상태
-        size += GET_SIZE(HDRP(PREV_BLKP(bp))); 
-        PUT(FTRP(bp), PACK(size, 0)); 
-        remove_free_block(PREV_BLKP(bp), GET_SIZE(HDRP(PREV_BLKP(bp))));
-        bp = PREV_BLKP(bp); // 헤더는 앞블럭의 헤더위치로 옮겨 줘야 함.
-        PUT(HDRP(bp), PACK(size, 0)); // 그 다음 헤더 정보 갱신
-
-
-    } else { 
-        size += GET_SIZE(HDRP(PREV_BLKP(bp))) + GET_SIZE(FTRP(NEXT_BLKP(bp))); // 앞 뒤 블록 둘다 가용상태
-        remove_free_block(PREV_BLKP(bp), GET_SIZE(HDRP(PREV_BLKP(bp))));
-        remove_free_block(NEXT_BLKP(bp), GET_SIZE(FTRP(NEXT_BLKP(bp))));
-        bp = PREV_BLKP(bp); // 헤더를 앞블럭의 헤더위치로 옮겨 줘야 함.
-        PUT(HDRP(bp), PACK(size, 0)); 
-        PUT(FTRP(bp), PACK(size, 0));
-    }
-    add_free_block(bp, size);
+    put_header(HDRP(bp), PACK(size, BUSY)); // 헤더 푸터 정보 갱신. 앞블럭 상태는 맨 앞 블록 것 그대로.
+    lock = TAG_LOCK(HDRP(NEXT_BLKP(bp)));
+    spin_lock(lock);
+    PUT(FTRP(bp), PACK(size, 0));
+    __atomic_fetch_and((word_t *)HDRP(NEXT_BLKP(bp)), ~PREV_ALLOC, __ATOMIC_RELEASE); // 푸터를 쓴 뒤에 뒷블럭에게 앞블럭이 할당 안 됐다고 알려줌.
+    spin_unlock(lock);
     return bp;
 }
 
-// 메모리 블록의 크기를 변경할 때 사용됨. -> 기존 데이터를 새로운 블록으로 복사한 후 이전 블록을 해제함.
+// 메모리 블록의 크기를 변경할 때 사용됨.
+// 먼저 제자리에서 줄이거나 늘려보고(realloc_in_place), 안 될 때만 새 블록으로 기존 데이터를 복사한 후 이전 블록을 해제함.
+// 다른 아레나의 블록은 그 아레나 주인이 리스트를 쓰고 있으니 제자리 변경 없이 복사한다.
 void *mm_realloc(void *old_bp, size_t req_size) 
 {
     void *new_bp;
     size_t copySize;
-    
+    slab_t *slab;
+    arena_t *a;
+
+    if (old_bp == NULL) // realloc(NULL, size)는 malloc과 같음.
+        return mm_malloc(req_size);
+    if (req_size == 0) { // realloc(ptr, 0)은 free와 같음.
+        mm_free(old_bp);
+        return NULL;
+    }
+
+    if ((slab = slab_of(old_bp)) != NULL) { // 슬랩 칸은 칸 크기만큼
+        if (req_size <= slab->slot_size) // 칸 안에 들어가면 그대로
+            return old_bp;
+        copySize = slab->slot_size;
+    } else if (IS_HUGE(old_bp)) { // 따로 매핑한 블록은 계속 크면 mremap으로 복사 없이 크기만 바꿈
+        if (req_size >= mmap_threshold)
+            return huge_realloc(old_bp, req_size);
+        copySize = GET_SIZE(HDRP(old_bp)) - DSIZE;
+    } else {
+        a = arena_of(old_bp);
+        if (req_size < mmap_threshold && a == arena_get() && realloc_in_place(a, old_bp, adjust_size(req_size)))
+            return old_bp; // 임계값을 넘게 커지면 제자리에서 키우지 않고 따로 매핑한 블록으로 옮김
+        copySize = GET_SIZE(HDRP(old_bp)) - WSIZE; // 기존 블록의 크기에서 헤더 뺀 값을 복사, 새 블록으로 복사할 데이터의 크기 (할당된 블록엔 푸터가 없음)
+    }
+    // 새로운 블록을 할당할 땐 새로운 헤더가 필요하니까, 데이터만 복사함.
+
     new_bp = mm_malloc(req_size); 
     if (new_bp == NULL) // 할당 실패! 
       return NULL; 
 
-    copySize = GET_SIZE(HDRP(old_bp)) - DSIZE; // 기존 블록의 크기에서 헤더와 푸터 뺀 값을 복사, 새 블록으로 복사할 데이터의 크기
-    // 새로운 블록을 할당할 땐 새로운 헤더와 푸터가 필요하니까, 데이터만 복사함.
-
     if (req_size < copySize) // 요청한 크기(이것도 데이터만의 크기임)가 현재 블록크기보다 작으면 요청된 크기로 맞춰줌.
       copySize = req_size;
 
@@ -321,3 +1679,50 @@ void *mm_realloc(void *old_bp, size_t req_size)
     return new_bp;
 }
 
+// 요청 크기 + 헤더 자리(DSIZE)를 페이지 단위로 올린 매핑 길이. 넘치면 0.
+static size_t huge_size(size_t req_size)
+{
+    size_t page = mem_pagesize();
+    size_t size = (req_size + DSIZE + page - 1) & ~(page - 1);
+
+    if (size < req_size) // 넘침
+        return 0;
+    return size;
+}
+
+// 큰 블록 하나를 힙 밖에 따로 매핑함. 매핑 시작이 페이지 정렬이니 bp = 시작 + DSIZE도 정렬됨.
+static void *huge_alloc(size_t req_size)
+{
+    size_t size = huge_size(req_size);
+    char *p;
+
+    if (size == 0 || (p = mem_map(size)) == (void *)-1)
+        return NULL;
+    PUT(p + DSIZE - WSIZE, PACK(size, HUGE | 1));
+    return p + DSIZE;
+}
+
+// 큰 블록의 매핑 크기를 바꿈. 커질 때도 페이지를 옮겨 붙이므로 데이터를 복사하지 않는다.
+static void *huge_realloc(void *bp, size_t req_size)
+{
+    size_t old_size = GET_SIZE(HDRP(bp));
+    size_t size = huge_size(req_size);
+    char *p;
+
+    if (size == 0)
+        return NULL;
+    if (size == old_size)
+        return bp;
+    if ((p = mem_remap((char *)bp - DSIZE, old_size, size)) == (void *)-1)
+        return NULL;
+    PUT(p + DSIZE - WSIZE, PACK(size, HUGE | 1));
+    return p + DSIZE;
+}
+
+static void huge_free(void *bp)
+{
+    mem_unmap((char *)bp - DSIZE, GET_SIZE(HDRP(bp)));
+}
+
+// mdriver에서 고를 수 있게 내보내는 함수 표. 심볼 이름은 MM_PREFIX를 따라감(mm.h).
+const mm_backend_t mm_backend = { MM_BACKEND_NAME, mm_init, mm_malloc, mm_free, mm_realloc };
@@ -1,10 +1,49 @@
 #include <stdio.h>
 
+/*
+ * Several allocators are linked into one driver. Every allocator
+ * except mm.c is compiled with -DMM_PREFIX=<name>, which renames its
+ * mm_init, mm_malloc, mm_free, mm_realloc and team to <name>_init,
+ * <name>_malloc, ... so the symbols don't collide. Each allocator
+ * exports its functions in an mm_backend_t named <name>_backend
+ * (mm_backend for mm.c).
+ */
+#ifdef MM_PREFIX
+#define MM_CAT2(a, b)    a##_##b
+#define MM_CAT(a, b)     MM_CAT2(a, b)
+#define MM_STR2(a)       #a
+#define MM_STR(a)        MM_STR2(a)
+#define MM_BACKEND_NAME  MM_STR(MM_PREFIX)
+#define mm_init          MM_CAT(MM_PREFIX, init)
+#define mm_malloc        MM_CAT(MM_PREFIX, malloc)
+#define mm_free          MM_CAT(MM_PREFIX, free)
+#define mm_realloc       MM_CAT(MM_PREFIX, realloc)
+#define mm_backend       MM_CAT(MM_PREFIX, backend)
+#define team             MM_CAT(MM_PREFIX, team)
+#else
+#define MM_BACKEND_NAME  "mm"
+#endif
+
 extern int mm_init (void);
 extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 
+/* One allocator as seen by the driver */
+typedef struct {
+    const char *name;                       /* name used with mdriver -b */
+    int (*init)(void);
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+} mm_backend_t;
+
+extern const mm_backend_t mm_backend;
+
+/* mm.c only, used by mstress to check cross-thread frees */
+extern void mm_thread_flush(void);
+extern void mm_remote_stats(size_t *pushed, size_t *drained);
+
 
 /* 
  * Students work in teams of one or two.  Teams enter their team name, 
@@ -0,0 +1,362 @@
+/*
+ * mstress.c - Multi-threaded stress driver for the mm.c malloc package
+ *
+ * Every worker thread keeps its own table of live blocks and runs a
+ * random mix of mm_malloc, mm_free and mm_realloc against the shared
+ * heap. Each payload is filled with a per-block byte pattern that is
+ * checked again before the block is freed or reallocated, so blocks
+ * handed out twice or overwritten by the allocator are caught.
+ *
+ * The same per-thread workload is run with 1, 2, 4, ... threads and the
+ * driver reports the aggregate throughput and the speedup over the
+ * single-threaded run.
+ *
+ * With -x, a freed block is instead handed to the next thread, (i+1)%N,
+ * through a single-producer/single-consumer ring, and that thread
+ * checks and frees it. Each thread gets its own arena, so these frees
+ * go through the owner's remote-free stack. At the end every thread
+ * flushes twice, and the run fails unless every block pushed on a
+ * remote-free stack has been drained back to its owner arena.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+/* Defaults for the command line options */
+#define DEF_THREADS  8       /* largest thread count to run */
+#define DEF_OPS      200000  /* operations per thread */
+#define DEF_SLOTS    1000    /* live blocks per thread */
+#define DEF_MAXSIZE  512     /* largest request in bytes */
+
+#define MAX_THREADS  64
+#define RING_SIZE    256     /* blocks in flight to the next thread (power of 2) */
+
+/* One live block owned by a worker thread */
+typedef struct {
+    unsigned char *p;   /* payload returned by the allocator (or NULL) */
+    size_t size;        /* requested payload size */
+    unsigned char tag;  /* byte the payload was filled with */
+} slot_t;
+
+/* Blocks handed from one thread to the next (-x). Only the previous
+   thread writes tail and only the owner writes head. */
+typedef struct {
+    slot_t buf[RING_SIZE];
+    unsigned head;      /* next entry to take */
+    unsigned tail;      /* next entry to fill */
+} ring_t;
+
+/* Parameters and private state of one worker thread */
+typedef struct {
+    int id;
+    unsigned seed;
+    slot_t *slots;
+    ring_t *inbox;      /* blocks freed for the previous thread (-x) */
+    ring_t *outbox;     /* the next thread's inbox (-x) */
+} worker_t;
+
+static int num_ops = DEF_OPS;
+static int num_slots = DEF_SLOTS;
+static int max_size = DEF_MAXSIZE;
+static int verbose = 0;
+static int cross = 0;       /* hand freed blocks to the next thread */
+static int set_arenas = 0;  /* -x sets MM_ARENAS to the thread count */
+static size_t remote_frees; /* -x: remote frees in the last run */
+
+static pthread_barrier_t start_barrier;
+static pthread_barrier_t end_barrier;
+
+/*
+ * check_slot - Verify that a live block still holds its fill pattern
+ */
+static void check_slot(worker_t *w, slot_t *s)
+{
+    size_t i;
+
+    for (i = 0; i < s->size; i++) {
+        if (s->p[i] != s->tag) {
+            fprintf(stderr, "ERROR: thread %d: payload %p corrupted at byte %lu\n",
+                    w->id, (void *)s->p, (unsigned long)i);
+            exit(1);
+        }
+    }
+}
+
+/*
+ * fill_slot - Stamp a live block with a fresh fill pattern
+ */
+static void fill_slot(worker_t *w, slot_t *s)
+{
+    s->tag = (unsigned char)rand_r(&w->seed);
+    memset(s->p, s->tag, s->size);
+}
+
+/*
+ * ring_put - Hand a live block to the next thread, return 0 if the ring is full
+ */
+static int ring_put(ring_t *r, slot_t *s)
+{
+    unsigned tail = r->tail;
+
+    if (tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == RING_SIZE)
+        return 0;
+    r->buf[tail & (RING_SIZE - 1)] = *s;
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/*
+ * ring_get - Take a block handed over by the previous thread, return 0 if none
+ */
+static int ring_get(ring_t *r, slot_t *s)
+{
+    unsigned head = r->head;
+
+    if (head == __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE))
+        return 0;
+    *s = r->buf[head & (RING_SIZE - 1)];
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/*
+ * drain_inbox - Check and free every block the previous thread handed over
+ */
+static void drain_inbox(worker_t *w)
+{
+    slot_t s;
+
+    while (ring_get(w->inbox, &s)) {
+        check_slot(w, &s);
+        mm_free(s.p);
+    }
+}
+
+/*
+ * worker - Run num_ops random requests on the thread's private slot table
+ */
+static void *worker(void *arg)
+{
+    worker_t *w = arg;
+    slot_t *s;
+    unsigned char *newp;
+    size_t newsize;
+    int i;
+
+    pthread_barrier_wait(&start_barrier);
+    for (i = 0; i < num_ops; i++) {
+        if (cross)
+            drain_inbox(w);
+        s = &w->slots[rand_r(&w->seed) % num_slots];
+        newsize = 1 + rand_r(&w->seed) % max_size;
+
+        if (s->p == NULL) {                       /* empty slot: malloc */
+            if ((s->p = mm_malloc(newsize)) == NULL) {
+                fprintf(stderr, "ERROR: thread %d: mm_malloc(%lu) failed\n",
+                        w->id, (unsigned long)newsize);
+                exit(1);
+            }
+            s->size = newsize;
+            fill_slot(w, s);
+        }
+        else if (rand_r(&w->seed) % 4 == 0) {    /* live slot: realloc */
+            check_slot(w, s);
+            if ((newp = mm_realloc(s->p, newsize)) == NULL) {
+                fprintf(stderr, "ERROR: thread %d: mm_realloc(%lu) failed\n",
+                        w->id, (unsigned long)newsize);
+                exit(1);
+            }
+            if (newsize < s->size)
+                s->size = newsize;
+            s->p = newp;
+            check_slot(w, s);                     /* old data must survive */
+            s->size = newsize;
+            fill_slot(w, s);
+        }
+        else {                                    /* live slot: free */
+            check_slot(w, s);
+            if (!cross || !ring_put(w->outbox, s))  /* -x: the next thread frees it */
+                mm_free(s->p);
+            s->p = NULL;
+        }
+    }
+
+    /* Release everything this thread still holds */
+    for (i = 0; i < num_slots; i++) {
+        if (w->slots[i].p != NULL) {
+            check_slot(w, &w->slots[i]);
+            mm_free(w->slots[i].p);
+            w->slots[i].p = NULL;
+        }
+    }
+
+    /* -x: free what is still in flight, then send cached blocks home
+       and take back the blocks the other threads sent */
+    if (cross) {
+        pthread_barrier_wait(&end_barrier);
+        drain_inbox(w);
+        mm_thread_flush();
+        pthread_barrier_wait(&end_barrier);
+        mm_thread_flush();
+    }
+    return NULL;
+}
+
+/*
+ * run - Run the workload with nthreads threads, return elapsed seconds
+ */
+static double run(int nthreads)
+{
+    pthread_t tid[MAX_THREADS];
+    worker_t w[MAX_THREADS];
+    ring_t *rings;
+    struct timespec start, end;
+    size_t pushed, drained;
+    char buf[16];
+    int i;
+
+    if (set_arenas) {
+        sprintf(buf, "%d", nthreads);
+        setenv("MM_ARENAS", buf, 1);
+    }
+    mem_reset_brk();
+    if (mm_init() < 0) {
+        fprintf(stderr, "ERROR: mm_init failed\n");
+        exit(1);
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+    pthread_barrier_init(&end_barrier, NULL, nthreads);
+    if ((rings = calloc(nthreads, sizeof(ring_t))) == NULL) {
+        fprintf(stderr, "ERROR: calloc failed\n");
+        exit(1);
+    }
+    for (i = 0; i < nthreads; i++) {
+        w[i].id = i;
+        w[i].seed = 1 + i;
+        w[i].inbox = &rings[i];
+        w[i].outbox = &rings[(i + 1) % nthreads];
+        if ((w[i].slots = calloc(num_slots, sizeof(slot_t))) == NULL) {
+            fprintf(stderr, "ERROR: calloc failed\n");
+            exit(1);
+        }
+        pthread_create(&tid[i], NULL, worker, &w[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_barrier_wait(&start_barrier);
+    for (i = 0; i < nthreads; i++)
+        pthread_join(tid[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (i = 0; i < nthreads; i++)
+        free(w[i].slots);
+    free(rings);
+    pthread_barrier_destroy(&start_barrier);
+    pthread_barrier_destroy(&end_barrier);
+
+    /* -x: every remote free must be back in its owner arena */
+    if (cross) {
+        mm_remote_stats(&pushed, &drained);
+        if (pushed != drained) {
+            fprintf(stderr, "ERROR: %lu of %lu remote frees not drained to their arena\n",
+                    (unsigned long)(pushed - drained), (unsigned long)pushed);
+            exit(1);
+        }
+        if (set_arenas && nthreads > 1 && pushed == 0) {
+            fprintf(stderr, "ERROR: no block was freed through a remote-free stack\n");
+            exit(1);
+        }
+        remote_frees = pushed;
+    }
+
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mstress [-hvx] [-t <threads>] [-n <ops>] [-s <slots>] [-m <maxsize>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-m <size>  Largest request size in bytes (default %d).\n", DEF_MAXSIZE);
+    fprintf(stderr, "\t-n <ops>   Operations per thread (default %d).\n", DEF_OPS);
+    fprintf(stderr, "\t-s <slots> Live blocks per thread (default %d).\n", DEF_SLOTS);
+    fprintf(stderr, "\t-t <n>     Run with 1, 2, 4, ... up to n threads (default %d).\n", DEF_THREADS);
+    fprintf(stderr, "\t-v         Print heap size after each run.\n");
+    fprintf(stderr, "\t-x         Free blocks from the next thread, one arena per thread.\n");
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = DEF_THREADS;
+    int nthreads;
+    double secs, base = 0;
+    char c;
+
+    while ((c = getopt(argc, argv, "t:n:s:m:hvx")) != EOF) {
+        switch (c) {
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        case 'n':
+            num_ops = atoi(optarg);
+            break;
+        case 's':
+            num_slots = atoi(optarg);
+            break;
+        case 'm':
+            max_size = atoi(optarg);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'x':
+            cross = 1;
+            break;
+        case 'h':
+            usage();
+            exit(0);
+        default:
+            usage();
+            exit(1);
+        }
+    }
+    if (max_threads < 1 || max_threads > MAX_THREADS || num_ops < 1 ||
+        num_slots < 1 || max_size < 1) {
+        usage();
+        exit(1);
+    }
+
+    if (cross && getenv("MM_ARENAS") == NULL)
+        set_arenas = 1;
+    mem_init();
+
+    printf("%8s%12s%10s%10s%9s\n", "threads", "ops", "secs", "Kops", "speedup");
+    for (nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+        secs = run(nthreads);
+        if (nthreads == 1)
+            base = (double)num_ops / secs;
+        printf("%8d%12.0f%10.4f%10.0f%9.2f\n",
+               nthreads,
+               (double)num_ops * nthreads,
+               secs,
+               num_ops * nthreads / secs / 1e3,
+               (num_ops * nthreads / secs) / base);
+        if (verbose)
+            printf("        heap size %lu bytes\n", (unsigned long)mem_heapsize());
+        if (verbose && cross)
+            printf("        %lu remote frees, all drained\n", (unsigned long)remote_frees);
+    }
+
+    mem_deinit();
+    exit(0);
+}
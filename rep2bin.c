@@ -0,0 +1,87 @@
+/*
+ * rep2bin.c - Convert a text trace (.rep) into the binary trace format
+ *
+ * Usage: rep2bin <in.rep> <out.bin>
+ *
+ * The requests are streamed from the text file to the binary one, so
+ * traces of any length convert in constant memory. See trace.h for the
+ * layout; mdriver accepts either format wherever it takes a trace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+static char *out_path;  /* output file, removed if the conversion fails */
+
+static void die(char *msg, char *path)
+{
+    fprintf(stderr, "rep2bin: %s %s\n", msg, path);
+    if (out_path != NULL)
+	unlink(out_path);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in, *out;
+    bintrace_hdr_t hdr;
+    traceop_t op;
+    char type[16];
+    int max_index = -1, num_ops = 0;
+
+    if (argc != 3) {
+	fprintf(stderr, "Usage: %s <in.rep> <out.bin>\n", argv[0]);
+	exit(1);
+    }
+    if ((in = fopen(argv[1], "r")) == NULL)
+	die("could not open", argv[1]);
+    if ((out = fopen(argv[2], "wb")) == NULL)
+	die("could not create", argv[2]);
+    out_path = argv[2];
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = BINTRACE_MAGIC;
+    if (fscanf(in, "%d %d %d %d", &hdr.sugg_heapsize, &hdr.num_ids,
+	       &hdr.num_ops, &hdr.weight) != 4)
+	die("bad header in", argv[1]);
+    if (fwrite(&hdr, sizeof(hdr), 1, out) != 1)
+	die("write failed on", argv[2]);
+
+    /* Convert one request line at a time */
+    while (fscanf(in, "%15s", type) == 1) {
+	memset(&op, 0, sizeof(op));
+	switch (type[0]) {
+	case 'a':
+	case 'r':
+	    op.type = (type[0] == 'a') ? ALLOC : REALLOC;
+	    if (fscanf(in, "%d %d", &op.index, &op.size) != 2)
+		die("bad request in", argv[1]);
+	    break;
+	case 'f':
+	    op.type = FREE;
+	    if (fscanf(in, "%d", &op.index) != 1)
+		die("bad request in", argv[1]);
+	    break;
+	default:
+	    die("bogus request type in", argv[1]);
+	}
+	if (op.index < 0 || op.size < 0)
+	    die("bad request in", argv[1]);
+	if (op.index > max_index)
+	    max_index = op.index;
+	if (fwrite(&op, sizeof(op), 1, out) != 1)
+	    die("write failed on", argv[2]);
+	num_ops++;
+    }
+
+    /* The driver trusts these counts, so check them here */
+    if (num_ops != hdr.num_ops || max_index != hdr.num_ids - 1)
+	die("header counts don't match the requests in", argv[1]);
+    if (fclose(out) != 0)
+	die("write failed on", argv[2]);
+    fclose(in);
+    return 0;
+}
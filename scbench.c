@@ -0,0 +1,191 @@
+/*
+ * scbench.c - Microbenchmark for the size-class computation in mm.c
+ *
+ * Times three ways of mapping a block size to its free list:
+ *
+ *     loop    - the original find_next_power, which doubles a power of
+ *               two until it reaches the size
+ *     clz     - the same power-of-two class from one count-leading-zeros
+ *               (the current find_next_power in buddy1.c)
+ *     fl/sl   - sc_index() from sizeclass.h, with four sub-classes per
+ *               power of two (the classes used by mm.c), also from
+ *               one count-leading-zeros
+ *
+ * Before timing, sc_index() is checked against sc_min_size[] for every
+ * block size up to the largest size in the run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "sizeclass.h"
+
+#define DEF_SIZES   (1 << 16)  /* distinct sizes in the input array */
+#define DEF_ROUNDS  200        /* passes over the input array */
+#define DEF_MAXSIZE 4096       /* largest block size in bytes */
+
+#define FREE_LIST_NUMS 20      /* power-of-two lists in the original mm.c */
+
+static size_t *sizes;
+static int num_sizes = DEF_SIZES;
+static int rounds = DEF_ROUNDS;
+static int max_size = DEF_MAXSIZE;
+
+/* Sink for the computed classes so the loops are not optimized away */
+static volatile size_t sink;
+
+/*
+ * loop_power - find_next_power as originally written in mm.c and buddy1.c
+ */
+static size_t loop_power(size_t size)
+{
+    size_t power = 4;
+    size_t power_of_2 = 16;
+
+    if (size == 16)
+        return power;
+    while (power_of_2 < size) {
+        power_of_2 <<= 1;
+        power++;
+    }
+    if (power >= (FREE_LIST_NUMS + 3))
+        power = FREE_LIST_NUMS + 3;
+    return power;
+}
+
+/*
+ * clz_power - The same class computed with count-leading-zeros
+ */
+static size_t clz_power(size_t size)
+{
+    size_t power;
+
+    if (size <= 16)
+        return 4;
+    power = 32 - __builtin_clz((unsigned int)(size - 1));
+    if (power >= (FREE_LIST_NUMS + 3))
+        power = FREE_LIST_NUMS + 3;
+    return power;
+}
+
+/*
+ * flsl_index - The mm.c class from sizeclass.h
+ */
+static size_t flsl_index(size_t size)
+{
+    return sc_index(size);
+}
+
+/*
+ * check - Verify sc_index() against sc_min_size[] and the clz power against the loop
+ */
+static void check(void)
+{
+    size_t size;
+    unsigned int idx;
+
+    for (size = 16; size <= (size_t)max_size; size += 8) {
+        idx = sc_index(size);
+        if (size < sc_min_size[idx] ||
+            (idx < SC_NUM - 1 && size >= sc_min_size[idx + 1])) {
+            fprintf(stderr, "ERROR: sc_index(%lu) = %u is outside [%u, %u)\n",
+                    (unsigned long)size, idx, sc_min_size[idx],
+                    idx < SC_NUM - 1 ? sc_min_size[idx + 1] : 0);
+            exit(1);
+        }
+        if (clz_power(size) != loop_power(size)) {
+            fprintf(stderr, "ERROR: clz_power(%lu) = %lu, loop gives %lu\n",
+                    (unsigned long)size, (unsigned long)clz_power(size),
+                    (unsigned long)loop_power(size));
+            exit(1);
+        }
+    }
+}
+
+/*
+ * time_fn - Run fn over the input array and return nanoseconds per call
+ */
+static double time_fn(size_t (*fn)(size_t))
+{
+    struct timespec start, end;
+    size_t sum = 0;
+    int r, i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < rounds; r++)
+        for (i = 0; i < num_sizes; i++)
+            sum += fn(sizes[i]);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sink = sum;
+
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) /
+           ((double)rounds * num_sizes);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: scbench [-h] [-n <sizes>] [-r <rounds>] [-m <maxsize>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-m <size>  Largest block size in bytes (default %d).\n", DEF_MAXSIZE);
+    fprintf(stderr, "\t-n <n>     Number of random sizes (default %d).\n", DEF_SIZES);
+    fprintf(stderr, "\t-r <n>     Passes over the sizes (default %d).\n", DEF_ROUNDS);
+}
+
+int main(int argc, char **argv)
+{
+    double loop_ns, clz_ns, flsl_ns;
+    unsigned seed = 1;
+    char c;
+    int i;
+
+    while ((c = getopt(argc, argv, "n:r:m:h")) != EOF) {
+        switch (c) {
+        case 'n':
+            num_sizes = atoi(optarg);
+            break;
+        case 'r':
+            rounds = atoi(optarg);
+            break;
+        case 'm':
+            max_size = atoi(optarg);
+            break;
+        case 'h':
+            usage();
+            exit(0);
+        default:
+            usage();
+            exit(1);
+        }
+    }
+    if (num_sizes < 1 || rounds < 1 || max_size < 16) {
+        usage();
+        exit(1);
+    }
+
+    check();
+
+    /* Random block sizes: multiples of 8, at least 16 */
+    if ((sizes = malloc(num_sizes * sizeof(size_t))) == NULL) {
+        fprintf(stderr, "ERROR: malloc failed\n");
+        exit(1);
+    }
+    for (i = 0; i < num_sizes; i++)
+        sizes[i] = 16 + 8 * (rand_r(&seed) % ((max_size - 16) / 8 + 1));
+
+    loop_ns = time_fn(loop_power);
+    clz_ns = time_fn(clz_power);
+    flsl_ns = time_fn(flsl_index);
+
+    printf("%8s%10s%9s\n", "method", "ns/op", "speedup");
+    printf("%8s%10.2f%9.2f\n", "loop", loop_ns, 1.0);
+    printf("%8s%10.2f%9.2f\n", "clz", clz_ns, loop_ns / clz_ns);
+    printf("%8s%10.2f%9.2f\n", "fl/sl", flsl_ns, loop_ns / flsl_ns);
+
+    free(sizes);
+    exit(0);
+}
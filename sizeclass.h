@@ -0,0 +1,41 @@
+/*
+ * sizeclass.h - Size classes for the mm.c segregated free lists
+ *
+ * Generated by gensc. Do not edit; change gensc.c and run "make sizeclass.h".
+ */
+#ifndef __SIZECLASS_H_
+#define __SIZECLASS_H_
+
+#include <stddef.h>
+
+#define SC_SL_LOG2    2
+#define SC_SL_COUNT   4
+#define SC_FL_MIN     4
+#define SC_FL_MAX     11
+#define SC_NUM        32
+
+/* Smallest block size in each class */
+static const unsigned int sc_min_size[SC_NUM] = {
+    16, 20, 24, 28, 32, 40, 48, 56,
+    64, 80, 96, 112, 128, 160, 192, 224,
+    256, 320, 384, 448, 512, 640, 768, 896,
+    1024, 1280, 1536, 1792, 2048, 2560, 3072, 3584
+};
+
+/*
+ * sc_index - Class of a block of the given size (a multiple of 8)
+ */
+static inline unsigned int sc_index(size_t size)
+{
+    unsigned int fl;
+
+    if (size < (size_t)1 << SC_FL_MIN)
+        return 0;
+    if (size >= (size_t)1 << (SC_FL_MAX + 1))
+        return SC_NUM - 1;
+    fl = 31 - __builtin_clz((unsigned int)size);
+    return ((fl - SC_FL_MIN) << SC_SL_LOG2) |
+           ((size >> (fl - SC_SL_LOG2)) & (SC_SL_COUNT - 1));
+}
+
+#endif /* __SIZECLASS_H_ */
@@ -0,0 +1,37 @@
+/*
+ * trace.h - Trace records shared by mdriver and rep2bin
+ *
+ * A binary trace (.bin) is a bintrace_hdr_t followed by num_ops packed
+ * traceop_t records in host byte order. mdriver maps the file and
+ * replays the records where they lie, so loading one costs page faults
+ * rather than parsing. rep2bin converts a text trace (.rep) into this
+ * format.
+ */
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+#include <stdint.h>
+
+#define BINTRACE_MAGIC 0x314d4d54  /* "TMM1" read as a little-endian word */
+
+/* Types of trace requests */
+enum {ALLOC, FREE, REALLOC};
+
+/* Characterizes a single trace operation (allocator request) */
+typedef struct {
+    int32_t type;    /* type of request: ALLOC, FREE or REALLOC */
+    int32_t index;   /* index for free() to use later */
+    int32_t size;    /* byte size of alloc/realloc request */
+} traceop_t;
+
+/* Header of a binary trace, the same four numbers that start a .rep */
+typedef struct {
+    uint32_t magic;          /* BINTRACE_MAGIC */
+    int32_t sugg_heapsize;   /* suggested heap size (unused) */
+    int32_t num_ids;         /* number of alloc/realloc ids */
+    int32_t num_ops;         /* number of distinct requests */
+    int32_t weight;          /* weight for this trace (unused) */
+    int32_t pad;             /* keeps the header a multiple of 8 bytes */
+} bintrace_hdr_t;
+
+#endif /* __TRACE_H_ */